@@ -155,6 +155,8 @@ $(call BUILD_PROGRAM, \
 	../lib)
 # Work around legacy code in external/websocketpp/*.hpp
 ase/websocket.cc.FLAGS = -Wno-deprecated-dynamic-exception-spec -Wno-sign-promo
+# SIMD kernels pass AVX vectors between always_inline helpers, no ABI is involved
+ase/datautils.cc.FLAGS = -Wno-psabi
 # Allow tests in mathutils.cc
 ase/mathutils.cc.CTIDY_FLAGS = --checks=-clang-analyzer-security.FloatLoopCounter
 
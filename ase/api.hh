@@ -227,6 +227,7 @@ public:
   virtual DeviceInfo device_info   () = 0;      ///< Describe this Device type.
   virtual DeviceS    list_devices  () = 0;      ///< List devices in order of processing, notified via "devs".
   void               remove_self   ();          ///< Remove device from its container.
+  TelemetryFieldS    render_telemetry ();     ///< Retrieve telemetry locations of the render time profile.
   // GUI handling
   virtual void       gui_toggle    () = 0;      ///< Toggle GUI display.
   virtual bool       gui_supported () = 0;      ///< Has GUI display facilities.
@@ -284,6 +285,8 @@ public:
   virtual int32           midi_channel        () const = 0;          ///< Midi channel assigned to this track, 0 uses internal per-track channel.
   virtual void            midi_channel        (int32 midichannel) = 0;
   virtual bool            is_master           () const = 0;          ///< Flag set on the main output track.
+  virtual bool            audio_input         () const = 0;          ///< Flag to feed PCM input into the track's device chain.
+  virtual void            audio_input         (bool enable) = 0;
   virtual ClipS           launcher_clips      () = 0;                ///< Retrieve the list of clips that can be directly played.
   virtual DeviceP         access_device       () = 0;                ///< Retrieve Device handle for this track.
   virtual MonitorP        create_monitor      (int32 ochannel) = 0;  /// Create signal monitor for an output channel.
@@ -305,6 +308,7 @@ public:
   virtual int32   get_ochannel       () = 0;            ///< Retrieve output channel the Monitor is connected to.
   virtual int64   get_mix_freq       () = 0;            ///< Mix frequency at which monitor values are calculated.
   virtual int64   get_frame_duration () = 0;            ///< Frame duration in µseconds for the calculation of monitor values.
+  virtual TelemetryFieldS telemetry  () const = 0;      ///< Retrieve telemetry locations of peak, RMS and scope values.
   //int64         get_shm_offset     (MonitorField fld);  ///< Offset into shared memory for MonitorField values of `ochannel`.
   //void          set_probe_features (ProbeFeatures pf);  ///< Configure probe features.
   //ProbeFeatures get_probe_features ();                  ///< Get configured probe features.
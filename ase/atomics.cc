@@ -183,4 +183,39 @@ atomic_valuestack_test()
   TASSERT (sstack.empty());
 }
 
+// == SpscRing<> test ==
+TEST_INTEGRITY (spsc_ring_test);
+static void
+spsc_ring_test()
+{
+  SpscRing<int> ring (3);
+  TASSERT (ring.empty() && ring.capacity() == 3 && ring.space() == 3);
+  int v = 0;
+  TASSERT (!ring.pop (v));
+  TASSERT (ring.push (1) && ring.push (2) && ring.push (3));
+  TASSERT (!ring.push (4) && ring.space() == 0);
+  TASSERT (ring.pop (v) && v == 1);
+  TASSERT (ring.space() == 1 && ring.push (4));
+  TASSERT (ring.pop (v) && v == 2 && ring.pop (v) && v == 3 && ring.pop (v) && v == 4);
+  TASSERT (ring.empty() && ring.space() == 3);
+  // concurrent producer and consumer
+  constexpr uint64 N_VALUES = 100000;
+  SpscRing<uint64> uring (64);
+  std::thread producer ([&uring] () {
+    for (uint64 i = 1; i <= N_VALUES; i++)
+      while (!uring.push (i))
+        std::this_thread::yield();
+  });
+  uint64 last = 0, sum = 0, u;
+  while (last < N_VALUES)
+    if (uring.pop (u))
+      {
+        TASSERT (u == last + 1);
+        last = u;
+        sum += u;
+      }
+  producer.join();
+  TASSERT (sum == N_VALUES * (N_VALUES + 1) / 2 && uring.empty());
+}
+
 } // Anon
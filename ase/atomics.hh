@@ -225,6 +225,53 @@ private:
   }
 };
 
+// == SpscRing ==
+/** Lock-free ring buffer with fixed capacity for a single producer and a single consumer thread.
+ * All memory is allocated by the constructor, push() and pop() never allocate.
+ */
+template<typename Value>
+class SpscRing {
+  std::vector<Value>  ring_;
+  std::atomic<size_t> head_ alignas (64) = 0;   // next slot to write, owned by the producer
+  std::atomic<size_t> tail_ alignas (64) = 0;   // next slot to read, owned by the consumer
+  size_t next (size_t i) const { return i + 1 == ring_.size() ? 0 : i + 1; }
+public:
+  explicit SpscRing (size_t capacity) : ring_ (capacity + 1) {}
+  /// Maximum number of values the ring can hold.
+  size_t capacity () const      { return ring_.size() - 1; }
+  /// Return `true` if no values can be popped, consumer side.
+  bool   empty    () const      { return tail_.load (std::memory_order_relaxed) == head_.load (std::memory_order_acquire); }
+  /// Number of values that can be pushed without failing, producer side.
+  size_t
+  space () const
+  {
+    const size_t head = head_.load (std::memory_order_relaxed), tail = tail_.load (std::memory_order_acquire);
+    return (tail > head ? tail - head : tail + ring_.size() - head) - 1;
+  }
+  /// Append a copy of `value`, returns `false` if the ring is full, producer side.
+  bool
+  push (const Value &value)
+  {
+    const size_t head = head_.load (std::memory_order_relaxed);
+    if (next (head) == tail_.load (std::memory_order_acquire))
+      return false;
+    ring_[head] = value;
+    head_.store (next (head), std::memory_order_release);
+    return true;
+  }
+  /// Move the oldest value into `value`, returns `false` if the ring is empty, consumer side.
+  bool
+  pop (Value &value)
+  {
+    const size_t tail = tail_.load (std::memory_order_relaxed);
+    if (tail == head_.load (std::memory_order_acquire))
+      return false;
+    value = std::move (ring_[tail]);
+    tail_.store (next (tail), std::memory_order_release);
+    return true;
+  }
+};
+
 // == AtomicBits ==
 using AtomicU64 = std::atomic<uint64>;
 
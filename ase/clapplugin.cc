@@ -14,6 +14,13 @@
 #include <dlfcn.h>
 #include <glob.h>
 #include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #define CDEBUG(...)          Ase::debug ("clap", __VA_ARGS__)
 #define CDEBUG_ENABLED()     Ase::debug_key_enabled ("clap")
@@ -25,7 +32,10 @@ namespace Ase {
 
 ASE_CLASS_DECLS (ClapAudioProcessor);
 ASE_CLASS_DECLS (ClapPluginHandleImpl);
-using ClapEventParamS = std::vector<clap_event_param_value>;
+struct ClapEventParam : clap_event_param_value {
+  int64_t steady_time = 0;      // engine frame_counter() stamp, 0 for immediate delivery
+};
+using ClapEventParamS = std::vector<ClapEventParam>;
 union ClapEventUnion;
 using ClapEventUnionS = std::vector<ClapEventUnion>;
 using ClapResourceHash = std::tuple<clap_id,String>; // resource_id, hex_hash
@@ -40,6 +50,7 @@ static String                clapid                   (const clap_host *host);
 static ClapPluginHandleImpl* handle_ptr               (const clap_host *host);
 static ClapPluginHandleImplP handle_sptr              (const clap_host *host);
 static const clap_plugin*    access_clap_plugin       (ClapPluginHandle *handle);
+static void                  restart_pending_handles  ();
 static const void*           host_get_extension_mt    (const clap_host *host, const char *extension_id);
 static void                  host_request_restart_mt  (const clap_host *host);
 static void                  host_request_process_mt  (const clap_host *host);
@@ -217,6 +228,77 @@ union ClapEventUnion {
   clap_event_midi2_t           midi2;         // CLAP_NOTE_DIALECT_MIDI2
 };
 
+// == ClapEventPage ==
+/// Event list with fixed capacity, storage is allocated upfront and reused for every process() call.
+class ClapEventPage {
+  std::vector<ClapEventUnion> events_;
+  uint32_t size_ = 0;
+public:
+  explicit              ClapEventPage (uint32_t capacity) : events_ (capacity) {}
+  uint32_t              size        () const                { return size_; }
+  void                  clear       ()                      { size_ = 0; }
+  ClapEventUnion&       operator[]  (size_t i)              { return events_[i]; }
+  const ClapEventUnion* begin       () const                { return &events_[0]; }
+  const ClapEventUnion* end         () const                { return &events_[size_]; }
+  void                  pop         ()                      { size_ -= size_ > 0; }
+  /// Append an uninitialized event, returns `nullptr` if the page is full.
+  ClapEventUnion*
+  push ()
+  {
+    return size_ < events_.size() ? &events_[size_++] : nullptr;
+  }
+  /// Append a copy of `event` if it fits.
+  bool
+  try_push (const clap_event_header_t *event)
+  {
+    ClapEventUnion *evunion = event->size <= sizeof (ClapEventUnion) ? push() : nullptr;
+    if (evunion)
+      memcpy (evunion, event, event->size);
+    return evunion != nullptr;
+  }
+};
+
+/// Move events from `queue` that are due within the block of `n_frames` at `block_start` into `events`.
+/// Events stamped before `block_start` are due at frame 0, parameter changes precede notes at the same frame.
+/// Returns the number of `queue` events consumed.
+static uint
+clap_merge_param_events (const ClapEventParam *queue, uint n_queued, int64_t block_start, uint n_frames, ClapEventPage &events)
+{
+  const int64_t block_end = block_start + n_frames;
+  uint n = 0;
+  for (; n < n_queued && queue[n].steady_time < block_end; n++) {
+    const ClapEventParam &pevent = queue[n];
+    ClapEventUnion *evunion = events.push();
+    if (!evunion)
+      break;                            // page is full, deliver remaining events in the next block
+    evunion->value = pevent;
+    evunion->value.header.time = pevent.steady_time > block_start ? pevent.steady_time - block_start : 0;
+    const ClapEventUnion event = *evunion;
+    size_t j = events.size() - 1;
+    while (j > 0 && (events[j - 1].header.time > event.header.time ||
+                     (events[j - 1].header.time == event.header.time &&
+                      events[j - 1].header.type != CLAP_EVENT_PARAM_VALUE)))
+      {
+        events[j] = events[j - 1];
+        j--;
+      }
+    events[j] = event;
+  }
+  return n;
+}
+
+/// Reduce `pevents` to the last update of each parameter, keeping the order of the remaining events.
+static void
+clap_coalesce_param_events (ClapEventParamS &pevents)
+{
+  ClapEventParamS coalesced;
+  for (auto it = pevents.rbegin(); it != pevents.rend(); ++it)
+    if (std::none_of (coalesced.begin(), coalesced.end(), [it] (const ClapEventParam &e) { return e.param_id == it->param_id; }))
+      coalesced.push_back (*it);
+  std::reverse (coalesced.begin(), coalesced.end());
+  pevents.swap (coalesced);
+}
+
 // == ClapAudioProcessor ==
 class ClapAudioProcessor : public AudioProcessor {
   ClapPluginHandle *handle_ = nullptr;
@@ -229,6 +311,9 @@ class ClapAudioProcessor : public AudioProcessor {
   clap_note_dialect output_event_dialect = clap_note_dialect (0);
   clap_note_dialect output_preferred_dialect = clap_note_dialect (0);
   bool can_process_ = false;
+  bool in_process_ = false;
+  std::atomic<bool> restart_pending_ = false;
+  uint process_rate_ = 0;
 public:
   static void
   static_info (AudioProcessorInfo &info)
@@ -238,14 +323,9 @@ public:
   ClapAudioProcessor (const ProcessorSetup &psetup) :
     AudioProcessor (psetup)
   {}
-  ~ClapAudioProcessor()
-  {
-    while (enqueued_events_.size()) {
-      ClapEventParamS *pevents = enqueued_events_.back();
-      enqueued_events_.pop_back();
-      main_rt_jobs += RtCall (call_delete<ClapEventParamS>, pevents); // delete in main_thread
-    }
-  }
+  using AudioProcessor::set_latency;
+  using AudioProcessor::set_tail;
+  using AudioProcessor::TAIL_INFINITE;
   void
   initialize (SpeakerArrangement busses) override
   {
@@ -286,15 +366,10 @@ public:
     if (omain_clapidx < audio_oport_infos.size())
       obusid = add_output_bus (audio_oport_infos[omain_clapidx].name, SpeakerArrangement::STEREO);
     // prepare event IO
-    if (input_event_dialect & (CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI)) {
+    if (input_event_dialect & (CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI))
       prepare_event_input();
-      input_events_.reserve (256); // avoid audio-thread allocations
-    }
-    if (output_event_dialect & (CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI)) {
+    if (output_event_dialect & (CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI))
       prepare_event_output();
-      output_events_.reserve (256); // avoid audio-thread allocations
-    }
-    enqueued_events_.reserve (8);
 
     // workaround AudioProcessor asserting that a Processor should have *some* IO facilities
     if (!has_event_output() && !has_event_input() && ibusid == 0 && obusid == 0)
@@ -302,35 +377,33 @@ public:
   }
   void
   reset (uint64 target_stamp) override
-  {}
+  {
+    // plugins are activated for a fixed sample rate, re-activate after engine rate changes
+    if (can_process_ && process_rate_ != sample_rate() && !restart_pending_.exchange (true))
+      main_rt_jobs += RtCall (restart_pending_handles);
+  }
   void convert_clap_events (const clap_process_t &process, bool as_clapnotes);
-  std::vector<ClapEventUnion> input_events_;
-  std::vector<ClapEventUnion> output_events_;
+  static constexpr uint EVENT_PAGE_SIZE = 512;
+  static constexpr uint PARAM_QUEUE_SIZE = 512;
+  ClapEventPage input_events_ { EVENT_PAGE_SIZE };
+  ClapEventPage output_events_ { EVENT_PAGE_SIZE };
   static uint32_t
   input_events_size (const clap_input_events *evlist)
   {
     ClapAudioProcessor *self = (ClapAudioProcessor*) evlist->ctx;
-    size_t param_events_size = 0;
-    for (const auto &pevents_b : self->enqueued_events_)
-      param_events_size += pevents_b->size();
-    return param_events_size + self->input_events_.size();
+    return self->input_events_.size();
   }
   static const clap_event_header_t*
   input_events_get (const clap_input_events *evlist, uint32_t index)
   {
     ClapAudioProcessor *self = (ClapAudioProcessor*) evlist->ctx;
-    for (const auto &pevents_b : self->enqueued_events_) {
-      if (index < pevents_b->size())
-        return &(*pevents_b)[index].header;
-      index -= pevents_b->size();
-    }
     return index < self->input_events_.size() ? &self->input_events_[index].header : nullptr;
   }
   static bool
   output_events_try_push (const clap_output_events *evlist, const clap_event_header_t *event)
   {
     ClapAudioProcessor *self = (ClapAudioProcessor*) evlist->ctx;
-    return event_unions_try_push (self->output_events_, event);
+    return self->output_events_.try_push (event);
   }
   const clap_input_events_t plugin_input_events = {
     .ctx = (ClapAudioProcessor*) this,
@@ -345,19 +418,19 @@ public:
   const ClapParamInfoImpl *param_info_map_start_ = nullptr;
   clap_process_t processinfo = { 0, };
   clap_event_transport_t transportinfo = { { 0, }, };
-  std::vector<ClapEventParamS*> enqueued_events_;
-  void
-  enqueue_events (ClapEventParamS *pevents)
+  SpscRing<ClapEventParam> param_ring_ { PARAM_QUEUE_SIZE };      // written by the main thread
+  std::vector<ClapEventParam> param_queue_ = std::vector<ClapEventParam> (PARAM_QUEUE_SIZE); // sorted by steady_time
+  uint param_queue_start_ = 0, param_queue_end_ = 0;
+  /// Queue parameter events for render() from the main thread, returns the number of events that fit.
+  size_t
+  enqueue_events (const ClapEventParam *pevents, size_t n_events)
   {
-    // insert 0-time event list *before* other events
-    if (pevents && pevents->size() && pevents->back().header.time == 0)
-      for (size_t i = 0; i < enqueued_events_.size(); i++)
-        if (enqueued_events_[i]->size() && enqueued_events_[i]->back().header.time > 0) {
-          enqueued_events_.insert (enqueued_events_.begin() + i, pevents);
-          return;
-        }
-    // or add to existing queue
-    enqueued_events_.push_back (pevents);
+    n_events = std::min (n_events, param_ring_.space());
+    for (size_t i = 0; i < n_events; i++)
+      param_ring_.push (pevents[i]);
+    if (n_events)
+      wakeup_mt();
+    return n_events;
   }
   bool
   start_processing (const ClapParamInfoMap *param_info_map, const ClapParamInfoImpl *map_start, size_t map_size)
@@ -368,6 +441,8 @@ public:
     param_info_map_start_ = map_start;
     atomic_bits_resize (map_size);
     can_process_ = clapplugin_->start_processing (clapplugin_);
+    process_rate_ = sample_rate();
+    restart_pending_ = false;           // activation uses the current sample rate
     CDEBUG ("%s: %s: %d", handle_->clapid(), __func__, can_process_);
     if (can_process_) {
       processinfo = clap_process_t {
@@ -385,8 +460,8 @@ public:
           .type     = CLAP_EVENT_TRANSPORT
         }
       };
-      input_events_.resize (0);
-      output_events_.resize (0);
+      input_events_.clear();
+      output_events_.clear();
     }
     return can_process_;
   }
@@ -398,9 +473,11 @@ public:
     clapplugin_->stop_processing (clapplugin_);
     param_info_map_ = nullptr;
     param_info_map_start_ = nullptr;
+    set_latency (0);
+    set_tail (TAIL_INFINITE);
     CDEBUG ("%s: %s", handle_->clapid(), __func__);
-    input_events_.resize (0);
-    output_events_.resize (0);
+    input_events_.clear();
+    output_events_.clear();
   }
   void
   update_transportinfo()
@@ -418,7 +495,7 @@ public:
     transportinfo.song_pos_beats      = llrint (beat_pos * CLAP_BEATTIME_FACTOR);
     transportinfo.song_pos_seconds    = llrint (sec_pos * CLAP_SECTIME_FACTOR);
     transportinfo.tempo               = tick_sig.bpm();
-    transportinfo.tempo_inc           = 0;
+    transportinfo.tempo_inc           = trans.running() ? trans.tempo_map.bpm_per_sample (trans.current_sample) : 0;
     transportinfo.loop_start_beats    = 0;
     transportinfo.loop_end_beats      = 0;
     transportinfo.loop_start_seconds  = 0;
@@ -445,14 +522,20 @@ public:
         processinfo.audio_outputs[omain_clapidx].data32[i] = oblock (obusid, i);
       }
       processinfo.frames_count = n_frames;
+      processinfo.steady_time = engine().frame_counter(); // block start, same clock as ClapParamUpdate
       convert_clap_events (processinfo, input_preferred_dialect & CLAP_NOTE_DIALECT_CLAP);
-      processinfo.steady_time += processinfo.frames_count;
+      merge_param_events (n_frames);
+      in_process_ = true;               // allow clap_host_thread_pool.request_exec()
       const clap_process_status status = clapplugin_->process (clapplugin_, &processinfo);
-      (void) status;
-      bool need_wakeup = dequeue_events (n_frames);
+      in_process_ = false;
+      bool need_wakeup = dequeue_events();
+      if (param_queue_start_ < param_queue_end_ || !param_ring_.empty())
+        keep_awake();                   // parameter changes are pending
+      else if (status == CLAP_PROCESS_SLEEP)
+        sleep_until_input();            // skip process() until input events or audio arrive
       for (const auto &e : output_events_)
         need_wakeup |= apply_param_value_event (e.value);
-      output_events_.resize (0);
+      output_events_.clear();
       if (need_wakeup)
         enotify_enqueue_mt (PARAMCHANGE);
       if (0)
@@ -460,6 +543,16 @@ public:
     }
   }
   bool
+  in_process () const
+  {
+    return in_process_;
+  }
+  bool
+  restart_pending ()
+  {
+    return restart_pending_.exchange (false);
+  }
+  bool
   apply_param_value_event (const clap_event_param_value &e)
   {
     bool need_wakeup = false;
@@ -478,19 +571,40 @@ public:
       }
     return need_wakeup;
   }
+  /// Move events from param_ring_ into param_queue_, keeping it sorted by steady_time.
+  void
+  fetch_param_events ()
+  {
+    if (param_queue_start_ == param_queue_end_)
+      param_queue_start_ = param_queue_end_ = 0;
+    else if (param_queue_end_ == PARAM_QUEUE_SIZE && param_queue_start_ > 0) {
+      // compact if full, amortized over all events that were consumed before
+      std::move (&param_queue_[param_queue_start_], &param_queue_[param_queue_end_], &param_queue_[0]);
+      param_queue_end_ -= param_queue_start_;
+      param_queue_start_ = 0;
+    }
+    while (param_queue_end_ < PARAM_QUEUE_SIZE && param_ring_.pop (param_queue_[param_queue_end_])) {
+      // insertion keeps events in enqueue order for equal steady_time
+      for (size_t j = param_queue_end_; j > param_queue_start_ && param_queue_[j - 1].steady_time > param_queue_[j].steady_time; j--)
+        std::swap (param_queue_[j - 1], param_queue_[j]);
+      param_queue_end_++;
+    }
+  }
+  /// Move parameter events due within `n_frames` into input_events_, ordered by frame.
+  void
+  merge_param_events (uint n_frames)
+  {
+    fetch_param_events();
+    param_queue_start_ += clap_merge_param_events (&param_queue_[param_queue_start_], param_queue_end_ - param_queue_start_,
+                                                   processinfo.steady_time, n_frames, input_events_);
+  }
   bool
-  dequeue_events (size_t nframes)
+  dequeue_events ()
   {
-    return_unless (enqueued_events_.size(), false);
-    // TODO: need proper time stamp handling
     bool need_wakeup = false;
-    while (enqueued_events_.size() && (enqueued_events_[0]->empty() || enqueued_events_[0]->back().header.time < nframes)) {
-      ClapEventParamS *const pevents = enqueued_events_[0];
-      enqueued_events_.erase (enqueued_events_.begin());
-      for (const auto &e : *pevents)
-        need_wakeup |= apply_param_value_event (e);
-      main_rt_jobs += RtCall (call_delete<ClapEventParamS>, pevents); // delete in main_thread
-    }
+    for (const auto &e : input_events_)
+      if (e.header.type == CLAP_EVENT_PARAM_VALUE)
+        need_wakeup |= apply_param_value_event (e.value);
     return need_wakeup;
   }
 };
@@ -539,11 +653,11 @@ void
 ClapAudioProcessor::convert_clap_events (const clap_process_t &process, const bool as_clapnotes)
 {
   MidiEventInput evinput = midi_event_input();
-  if (input_events_.capacity() < evinput.events_pending())
-    input_events_.reserve (evinput.events_pending() + 128);
-  input_events_.resize (evinput.events_pending());
-  uint j = 0;
-  for (const auto &ev : evinput)
+  input_events_.clear();
+  for (const auto &ev : evinput) {
+    ClapEventUnion *evunion = input_events_.push();
+    if (!evunion)
+      break;                            // page is full
     switch (ev.message())
       {
         clap_event_note_expression *expr;
@@ -554,21 +668,21 @@ ClapAudioProcessor::convert_clap_events (const clap_process_t &process, const bo
       case MidiMessage::NOTE_OFF:
       case MidiMessage::AFTERTOUCH:
         if (as_clapnotes && ev.type == MidiEvent::AFTERTOUCH) {
-          expr = setup_expression (&input_events_[j++], ev.frame, 0);
+          expr = setup_expression (evunion, ev.frame, 0);
           expr->expression_id = CLAP_NOTE_EXPRESSION_PRESSURE;
           expr->note_id = ev.noteid;
           expr->channel = ev.channel;
           expr->key = ev.key;
           expr->value = ev.velocity;
         } else if (as_clapnotes) {
-          evnote = setup_evnote (&input_events_[j++], ev.frame, 0);
+          evnote = setup_evnote (evunion, ev.frame, 0);
           evnote->header.type = ev.type == MidiEvent::NOTE_ON ? CLAP_EVENT_NOTE_ON : CLAP_EVENT_NOTE_OFF;
           evnote->note_id = ev.noteid;
           evnote->channel = ev.channel;
           evnote->key = ev.key;
           evnote->velocity = ev.velocity;
         } else {
-          midi1 = setup_midi1 (&input_events_[j++], ev.frame, 0);
+          midi1 = setup_midi1 (evunion, ev.frame, 0);
           midi1->data[0] = uint8_t (ev.type) | (ev.channel & 0xf);
           midi1->data[1] = ev.key;
           midi1->data[2] = std::min (uint8_t (ev.velocity * 127), uint8_t (127));
@@ -576,33 +690,33 @@ ClapAudioProcessor::convert_clap_events (const clap_process_t &process, const bo
         break;
       case MidiMessage::ALL_NOTES_OFF:
         if (as_clapnotes) {
-          evnote = setup_evnote (&input_events_[j++], ev.frame, 0);
+          evnote = setup_evnote (evunion, ev.frame, 0);
           evnote->header.type = CLAP_EVENT_NOTE_CHOKE;
           evnote->note_id = -1;
           evnote->channel = -1;
           evnote->key = -1;
           evnote->velocity = 0;
         } else {
-          midi1 = setup_midi1 (&input_events_[j++], ev.frame, 0);
+          midi1 = setup_midi1 (evunion, ev.frame, 0);
           midi1->data[0] = 0xB0 | (ev.channel & 0xf);
           midi1->data[1] = 123;
           midi1->data[2] = 0;
         }
         break;
       case MidiMessage::CONTROL_CHANGE:
-        midi1 = setup_midi1 (&input_events_[j++], ev.frame, 0);
+        midi1 = setup_midi1 (evunion, ev.frame, 0);
         midi1->data[0] = 0xB0 | (ev.channel & 0xf);
         midi1->data[1] = ev.param;
         midi1->data[2] = ev.cval;
         break;
       case MidiMessage::CHANNEL_PRESSURE:
-        midi1 = setup_midi1 (&input_events_[j++], ev.frame, 0);
+        midi1 = setup_midi1 (evunion, ev.frame, 0);
         midi1->data[0] = 0xD0 | (ev.channel & 0xf);
         midi1->data[1] = std::min (uint8_t (ev.velocity * 127), uint8_t (127));
         midi1->data[2] = 0;
         break;
       case MidiMessage::PITCH_BEND:
-        midi1 = setup_midi1 (&input_events_[j++], ev.frame, 0);
+        midi1 = setup_midi1 (evunion, ev.frame, 0);
         midi1->data[0] = 0xE0 | (ev.channel & 0xf);
         midi1->data[1] = std::min (uint8_t (ev.velocity * 127), uint8_t (127));
         midi1->data[2] = 0;
@@ -611,9 +725,10 @@ ClapAudioProcessor::convert_clap_events (const clap_process_t &process, const bo
         midi1->data[1] = i16 & 127;
         midi1->data[2] = (i16 >> 7) & 127;
         break;
-      default: ;
+      default:
+        input_events_.pop();            // unused
       }
-  input_events_.resize (j);
+  }
   if (debug_enabled()) // lock-free check
     {
       static bool evdebug = CLAPEVENT_ENABLED();
@@ -631,6 +746,9 @@ ClapAudioProcessor::convert_clap_events (const clap_process_t &process, const bo
 }
 
 // == ClapPluginHandleImpl ==
+static std::vector<ClapPluginHandleImpl*> active_handles; // activated plugins, main thread only
+static bool clap_render_offline = false;
+
 class ClapPluginHandleImpl final : public ClapPluginHandle {
 public:
   static String     clapid (const clap_host *host) { return Ase::clapid (host); }
@@ -660,6 +778,11 @@ public:
   const clap_plugin_audio_ports *plugin_audio_ports = nullptr;
   const clap_plugin_note_ports *plugin_note_ports = nullptr;
   const clap_plugin_posix_fd_support *plugin_posix_fd_support = nullptr;
+  const clap_plugin_latency *plugin_latency = nullptr;
+  const clap_plugin_tail *plugin_tail = nullptr;
+  const clap_plugin_thread_pool *plugin_thread_pool = nullptr;
+  const clap_plugin_render *plugin_render = nullptr;
+  bool realtime_hold_ = false;
   ClapPluginHandleImpl (const ClapPluginDescriptor &descriptor_, AudioProcessorP aproc) :
     ClapPluginHandle (descriptor_), proc_ (shared_ptr_cast<ClapAudioProcessor> (aproc))
   {
@@ -701,15 +824,10 @@ public:
     plugin_posix_fd_support = (const clap_plugin_posix_fd_support*) plugin_get_extension (CLAP_EXT_POSIX_FD_SUPPORT);
     plugin_state = (const clap_plugin_state*) plugin_get_extension (CLAP_EXT_STATE);
     plugin_file_reference = (const clap_plugin_file_reference*) plugin_get_extension (CLAP_EXT_FILE_REFERENCE);
-    const clap_plugin_render *plugin_render = nullptr;
     plugin_render = (const clap_plugin_render*) plugin_get_extension (CLAP_EXT_RENDER);
-    (void) plugin_render;
-    const clap_plugin_latency *plugin_latency = nullptr;
     plugin_latency = (const clap_plugin_latency*) plugin_get_extension (CLAP_EXT_LATENCY);
-    (void) plugin_latency;
-    const clap_plugin_tail *plugin_tail = nullptr;
     plugin_tail = (const clap_plugin_tail*) plugin_get_extension (CLAP_EXT_TAIL);
-    (void) plugin_tail;
+    plugin_thread_pool = (const clap_plugin_thread_pool*) plugin_get_extension (CLAP_EXT_THREAD_POOL);
     get_port_infos();
     return true;
   }
@@ -724,10 +842,12 @@ public:
   std::vector<ClapParamInfoImpl> param_infos_;
   ClapParamInfoMap param_ids_;
   ClapParamUpdateS *loader_updates_ = nullptr;
+  ClapEventParamS pending_params_;      // updates waiting for space in the processor queue
+  uint pending_timer_ = 0;
   void get_port_infos ();
   String get_param_value_text (clap_id param_id, double value);
   double get_param_value_double (clap_id param_id, const String &text);
-  ClapEventParamS* convert_param_updates (const ClapParamUpdateS &updates);
+  ClapEventParamS convert_param_updates (const ClapParamUpdateS &updates);
   void flush_event_params (const ClapEventParamS &events, ClapEventUnionS &output_events);
   void params_changed() override;
   void scan_params();
@@ -788,7 +908,7 @@ public:
     if (info->flags & CLAP_PARAM_IS_STEPPED)
       v = round (v);
     ClapParamUpdate update = {
-      .steady_time = 0, // NOW
+      .steady_time = int64_t (proc_->engine().frame_stamp()), // sample accurate spacing
       .param_id = param_id,
       .value = CLAMP (v, info->min_value, info->max_value),
     };
@@ -809,7 +929,7 @@ public:
         loader_updates_ = new ClapParamUpdateS;
         for (const auto &[id, value] : params)
           loader_updates_->push_back ({
-              .steady_time = 0, .param_id = id, .value = value,
+              .steady_time = 0, .param_id = id, .value = value, // flushed by clap_activate()
             });
         // TODO: flush loader_updates_ right away
       }
@@ -924,17 +1044,42 @@ public:
   {
     return plugin_activated;
   }
+  /// Send parameter updates to the processor, updates that do not fit into its queue are retried.
   bool
   enqueue_updates (const ClapParamUpdateS &updates)
   {
-    ClapPluginHandleImplP selfp = shared_ptr_cast<ClapPluginHandleImpl> (this);
     return_unless (clap_activated(), false);
-    ClapEventParamS *pevents = convert_param_updates (updates); // allocated in main_thread
-    proc_->engine().async_jobs += [selfp, pevents] () {
-      selfp->proc_->enqueue_events (pevents);
-    };
+    const ClapEventParamS pevents = convert_param_updates (updates);
+    pending_params_.insert (pending_params_.end(), pevents.begin(), pevents.end());
+    if (flush_pending_params())
+      return true;
+    // queue full, keep only the last value per parameter and retry from a timer
+    clap_coalesce_param_events (pending_params_);
+    CDEBUG ("%s: %s: parameter queue full, retrying %u events", clapid(), __func__, pending_params_.size());
+    if (!pending_timer_)
+      {
+        std::weak_ptr<ClapPluginHandleImpl> weakp = shared_ptr_cast<ClapPluginHandleImpl> (this);
+        pending_timer_ = main_loop->exec_timer ([weakp] () {
+          ClapPluginHandleImplP selfp = weakp.lock();
+          return_unless (selfp, false);
+          const bool keep_alive = !selfp->flush_pending_params();
+          if (!keep_alive)
+            selfp->pending_timer_ = 0;
+          return keep_alive;
+        }, 5, 5, EventLoop::PRIORITY_UPDATE);
+      }
     return true;
   }
+  /// Move pending_params_ into the processor queue, returns true once all are queued.
+  bool
+  flush_pending_params ()
+  {
+    if (!clap_activated())
+      pending_params_.clear(); // parameter updates are only sent to activated plugins
+    const size_t n = pending_params_.empty() ? 0 : proc_->enqueue_events (&pending_params_[0], pending_params_.size());
+    pending_params_.erase (pending_params_.begin(), pending_params_.begin() + n);
+    return pending_params_.empty();
+  }
   bool
   clap_activate() override
   {
@@ -945,19 +1090,18 @@ public:
     }
     // load parameter updates and rescan
     if (plugin_params && loader_updates_) {
-      ClapEventParamS *pevents = convert_param_updates (*loader_updates_);
+      const ClapEventParamS pevents = convert_param_updates (*loader_updates_);
       ClapEventUnionS output_events;
-      flush_event_params (*pevents, output_events);
+      flush_event_params (pevents, output_events);
       output_events.clear(); // discard output_events, we just do a rescan
       scan_params();
-      delete pevents;
     }
     if (loader_updates_) {
       delete loader_updates_;
       loader_updates_ = nullptr;
     }
     // activate, keeps param_ids_, param_infos_ locked now, start_processing
-    plugin_activated = plugin_->activate (plugin_, proc_->engine().sample_rate(), 32, 4096);
+    plugin_activated = plugin_->activate (plugin_, proc_->engine().sample_rate(), AUDIO_BLOCK_MIN_RENDER_SIZE, 4096);
     CDEBUG ("%s: %s: %d", clapid(), __func__, plugin_activated);
     if (plugin_activated) {
       ClapPluginHandleImplP selfp = shared_ptr_cast<ClapPluginHandleImpl> (this);
@@ -969,10 +1113,60 @@ public:
       };
       sem.wait();
       // active_state && processing_state
+      active_handles.push_back (this);
+      update_latency();
+      update_tail();
+      update_render_mode();
     }
     return clap_activated();
   }
   void
+  update_latency ()
+  {
+    return_unless (plugin_latency && clap_activated());
+    const uint latency = plugin_latency->get (plugin_);
+    CDEBUG ("%s: %s: %u", clapid(), __func__, latency);
+    ClapPluginHandleImplP selfp = shared_ptr_cast<ClapPluginHandleImpl> (this);
+    proc_->engine().async_jobs += [selfp, latency] () {
+      selfp->proc_->set_latency (latency);
+    };
+  }
+  void
+  update_tail ()
+  {
+    return_unless (plugin_tail && clap_activated());
+    const uint32_t tail = plugin_tail->get (plugin_); // INT32_MAX and above means infinite
+    CDEBUG ("%s: %s: %u", clapid(), __func__, tail);
+    ClapPluginHandleImplP selfp = shared_ptr_cast<ClapPluginHandleImpl> (this);
+    proc_->engine().async_jobs += [selfp, tail] () {
+      selfp->proc_->set_tail (tail >= INT32_MAX ? ClapAudioProcessor::TAIL_INFINITE : tail);
+    };
+  }
+  void
+  update_render_mode ()
+  {
+    return_unless (plugin_render && clap_activated());
+    // plugins with hard realtime requirements force PCM paced rendering
+    const bool hard_realtime = plugin_render->has_hard_realtime_requirement (plugin_);
+    if (hard_realtime != realtime_hold_) {
+      realtime_hold_ = hard_realtime;
+      proc_->engine().require_realtime (realtime_hold_);
+    }
+    const bool offline = !hard_realtime && clap_render_offline;
+    const bool ok = plugin_render->set (plugin_, offline ? CLAP_RENDER_OFFLINE : CLAP_RENDER_REALTIME);
+    CDEBUG ("%s: %s: offline=%d hard_realtime=%d: %s", clapid(), __func__, offline, hard_realtime, ok ? "OK" : "failed");
+  }
+  bool
+  request_exec (uint32_t n_tasks)
+  {
+    return_unless (plugin_thread_pool && AudioEngine::thread_is_audio() && proc_->in_process(), false);
+    proc_->engine().parallel_exec (n_tasks, [] (void *data, uint index) {
+      ClapPluginHandleImpl *self = (ClapPluginHandleImpl*) data;
+      self->plugin_thread_pool->exec (self->plugin_, index);
+    }, this);
+    return true;
+  }
+  void
   clap_deactivate() override
   {
     return_unless (plugin_ && clap_activated());
@@ -987,7 +1181,16 @@ public:
       // NOW: !processing && !clap_activated
     }
     plugin_activated = false;
+    Aux::erase_first (active_handles, [this] (ClapPluginHandleImpl *h) { return h == this; });
+    pending_params_.clear();
+    if (pending_timer_)
+      main_loop->remove (pending_timer_);
+    pending_timer_ = 0;
     plugin_->deactivate (plugin_);
+    if (realtime_hold_) {
+      realtime_hold_ = false;
+      proc_->engine().require_realtime (false);
+    }
     CDEBUG ("%s: plugin->deactivated", clapid());
   }
   void show_gui     () override;
@@ -1021,6 +1224,10 @@ public:
     plugin_audio_ports_config = nullptr;
     plugin_audio_ports = nullptr;
     plugin_note_ports = nullptr;
+    plugin_latency = nullptr;
+    plugin_tail = nullptr;
+    plugin_thread_pool = nullptr;
+    plugin_render = nullptr;
   }
   AudioProcessorP
   audio_processor () override
@@ -1106,10 +1313,10 @@ ClapPluginHandleImpl::params_changed ()
 }
 
 // == convert_param_updates ==
-ClapEventParamS*
+ClapEventParamS
 ClapPluginHandleImpl::convert_param_updates (const ClapParamUpdateS &updates)
 {
-  ClapEventParamS *param_events = new ClapEventParamS();
+  ClapEventParamS param_events;
   for (size_t i = 0; i < updates.size(); i++)
     {
       const ClapParamInfoImpl *pinfo = find_param_info (updates[i].param_id);
@@ -1118,7 +1325,7 @@ ClapPluginHandleImpl::convert_param_updates (const ClapParamUpdateS &updates)
       const clap_event_param_value event = {
         .header = {
           .size = sizeof (clap_event_param_value),
-          .time = 0, // updates[i].steady_time
+          .time = 0, // set from steady_time during process()
           .space_id = CLAP_CORE_EVENT_SPACE_ID,
           .type = CLAP_EVENT_PARAM_VALUE,
           .flags = CLAP_EVENT_DONT_RECORD,
@@ -1131,9 +1338,12 @@ ClapPluginHandleImpl::convert_param_updates (const ClapParamUpdateS &updates)
         .key = -1,
         .value = updates[i].value
       };
-      param_events->push_back (event);
+      param_events.push_back ({ event, updates[i].steady_time });
       PDEBUG ("%s: CONVERT: %08x=%f: (%s)\n", clapid(), pinfo->param_id, event.value, pinfo->name);
     }
+  std::stable_sort (param_events.begin(), param_events.end(), [] (const ClapEventParam &a, const ClapEventParam &b) {
+    return a.steady_time < b.steady_time;
+  });
   return param_events;
 }
 
@@ -1330,6 +1540,14 @@ access_clap_plugin (ClapPluginHandle *handle)
   return handle_ ? handle_->plugin_ : nullptr;
 }
 
+static void
+restart_pending_handles ()
+{
+  for (ClapPluginHandleImpl *handle : active_handles)
+    if (handle->proc_->restart_pending())
+      host_request_restart_mt (&handle->phost);
+}
+
 static bool
 event_unions_try_push (ClapEventUnionS &events, const clap_event_header_t *event)
 {
@@ -1410,7 +1628,7 @@ host_is_main_thread (const clap_host_t *host)
 static bool
 host_is_audio_thread (const clap_host_t *host)
 {
-  return AudioEngine::thread_is_engine();
+  return AudioEngine::thread_is_audio();
 }
 
 static const clap_host_thread_check host_ext_thread_check = {
@@ -1418,6 +1636,18 @@ static const clap_host_thread_check host_ext_thread_check = {
   .is_audio_thread = host_is_audio_thread,
 };
 
+// == clap_host_thread_pool ==
+static bool
+host_request_exec (const clap_host_t *host, uint32_t num_tasks)
+{
+  ClapPluginHandleImpl *handle = handle_ptr (host);
+  return handle->request_exec (num_tasks);
+}
+
+static const clap_host_thread_pool host_ext_thread_pool = {
+  .request_exec = host_request_exec,
+};
+
 // == clap_host_audio_ports ==
 static bool
 host_is_rescan_flag_supported (const clap_host_t *host, uint32_t flag)
@@ -1761,6 +1991,39 @@ static const clap_host_file_reference host_ext_file_reference = {
   .set_dirty = host_file_reference_set_dirty,
 };
 
+// == clap_host_latency ==
+static void
+host_latency_changed (const clap_host_t *host)
+{
+  CDEBUG ("%s: %s", clapid (host), __func__);
+  ClapPluginHandleImplP handlep = handle_sptr (host);
+  return_unless (handlep);
+  // usually called during activate(), so query the new latency afterwards
+  main_loop->exec_callback ([handlep] () {
+    handlep->update_latency();
+  });
+}
+
+static const clap_host_latency host_ext_latency = {
+  .changed = host_latency_changed,
+};
+
+// == clap_host_tail ==
+static void
+host_tail_changed (const clap_host_t *host)
+{
+  CDEBUG ("%s: %s", clapid (host), __func__);
+  ClapPluginHandleImplP handlep = handle_sptr (host);
+  return_unless (handlep);
+  main_loop->exec_callback ([handlep] () {
+    handlep->update_tail();
+  });
+}
+
+static const clap_host_tail host_ext_tail = {
+  .changed = host_tail_changed,
+};
+
 // == clap_host extensions ==
 static const void*
 host_get_extension_mt (const clap_host *host, const char *extension_id)
@@ -1771,9 +2034,12 @@ host_get_extension_mt (const clap_host *host, const char *extension_id)
   if (ext == CLAP_EXT_FILE_REFERENCE)   return &host_ext_file_reference;
   if (ext == CLAP_EXT_TIMER_SUPPORT)    return &host_ext_timer_support;
   if (ext == CLAP_EXT_THREAD_CHECK)     return &host_ext_thread_check;
+  if (ext == CLAP_EXT_THREAD_POOL)      return &host_ext_thread_pool;
   if (ext == CLAP_EXT_AUDIO_PORTS)      return &host_ext_audio_ports;
   if (ext == CLAP_EXT_PARAMS)           return &host_ext_params;
   if (ext == CLAP_EXT_POSIX_FD_SUPPORT) return &host_ext_posix_fd_support;
+  if (ext == CLAP_EXT_LATENCY)          return &host_ext_latency;
+  if (ext == CLAP_EXT_TAIL)             return &host_ext_tail;
   else return nullptr;
 }
 
@@ -1781,6 +2047,14 @@ static void
 host_request_restart_mt (const clap_host *host)
 {
   CDEBUG ("%s: %s", clapid (host), __func__);
+  ClapPluginHandleImplP handlep = handle_sptr (host);
+  return_unless (handlep);
+  main_loop->exec_callback ([handlep] () {
+    if (handlep->clap_activated()) {
+      handlep->clap_deactivate();
+      handlep->clap_activate();
+    }
+  });
 }
 
 static void
@@ -1826,17 +2100,80 @@ ClapPluginDescriptor::entry() const
   return clapfile_.opened() ? clapfile_.pluginentry : nullptr;
 }
 
-void
-ClapPluginDescriptor::add_descriptor (const String &pluginpath, Collection &infos)
+// == ClapScanCache ==
+struct ClapScanPlugin {
+  String id, name, version, vendor, features;
+  String description, url, manual_url, support_url;
+};
+using ClapScanPluginS = std::vector<ClapScanPlugin>;
+
+static void
+serialize (ClapScanPlugin &plugin, WritNode &xs)
+{
+  xs["id"] & plugin.id;
+  xs["name"] & plugin.name;
+  xs["version"] & plugin.version;
+  xs["vendor"] & plugin.vendor;
+  xs["features"] & plugin.features;
+  xs["description"] & plugin.description;
+  xs["url"] & plugin.url;
+  xs["manual_url"] & plugin.manual_url;
+  xs["support_url"] & plugin.support_url;
+}
+
+struct ClapScanEntry {
+  String          path, hash;           // hex blake3 of the file contents
+  int64           mtime = 0, size = 0;  // nanoseconds, bytes
+  bool            blacklisted = false;  // crashed or hung during scanning
+  ClapScanPluginS plugins;
+};
+using ClapScanEntryS = std::vector<ClapScanEntry>;
+
+static void
+serialize (ClapScanEntry &entry, WritNode &xs)
 {
-  ClapFileHandle *filehandle = new ClapFileHandle (pluginpath);
-  filehandle->open();
-  if (!filehandle->opened()) {
-    filehandle->close();
-    delete filehandle;
+  xs["path"] & entry.path;
+  xs["hash"] & entry.hash;
+  xs["mtime"] & entry.mtime;
+  xs["size"] & entry.size;
+  xs["blacklisted"] & entry.blacklisted;
+  xs["plugins"] & entry.plugins;
+}
+
+struct ClapScanCache {
+  String         clap_version;          // host CLAP version, entries are rescanned after changes
+  ClapScanEntryS entries;
+};
+
+static void
+serialize (ClapScanCache &cache, WritNode &xs)
+{
+  xs["clap_version"] & cache.clap_version;
+  xs["entries"] & cache.entries;
+}
+
+static constexpr uint64 CLAP_SCAN_TIMEOUT = 15 * 1000000; // µseconds per file
+static std::thread *clap_scan_thread = nullptr;
+static ClapScanEntryS clap_scan_entries;   // written by clap_scan_thread
+
+static String
+clap_scan_cache_path()
+{
+  static const String cachefile = Path::join (Path::cache_home(), "anklang", "clapscan.json");
+  return cachefile;
+}
+
+/// Load `clapfile` in the current process and list the plugins it provides.
+static void
+scan_clap_file (const String &clapfile, ClapScanPluginS &plugins)
+{
+  ClapFileHandle filehandle (clapfile);
+  filehandle.open();
+  if (!filehandle.opened()) {
+    filehandle.close();
     return;
   }
-  const clap_plugin_factory *pluginfactory = (const clap_plugin_factory *) filehandle->pluginentry->get_factory (CLAP_PLUGIN_FACTORY_ID);
+  const clap_plugin_factory *pluginfactory = (const clap_plugin_factory *) filehandle.pluginentry->get_factory (CLAP_PLUGIN_FACTORY_ID);
   const uint32_t plugincount = !pluginfactory ? 0 : pluginfactory->get_plugin_count (pluginfactory);
   for (size_t i = 0; i < plugincount; i++)
     {
@@ -1848,37 +2185,190 @@ ClapPluginDescriptor::add_descriptor (const String &pluginpath, Collection &info
         CDEBUG ("invalid plugin: %s (%s)", pdesc->id, clapversion);
         continue;
       }
-      ClapPluginDescriptor *descriptor = new ClapPluginDescriptor (*filehandle);
-      descriptor->id = pdesc->id;
-      descriptor->name = pdesc->name ? pdesc->name : pdesc->id;
-      descriptor->version = pdesc->version ? pdesc->version : "0.0.0-unknown";
-      descriptor->vendor = pdesc->vendor ? pdesc->vendor : "";
-      descriptor->url = pdesc->url ? pdesc->url : "";
-      descriptor->manual_url = pdesc->manual_url ? pdesc->manual_url : "";
-      descriptor->support_url = pdesc->support_url ? pdesc->support_url : "";
-      descriptor->description = pdesc->description ? pdesc->description : "";
+      ClapScanPlugin plugin;
+      plugin.id = pdesc->id;
+      plugin.name = pdesc->name ? pdesc->name : pdesc->id;
+      plugin.version = pdesc->version ? pdesc->version : "0.0.0-unknown";
+      plugin.vendor = pdesc->vendor ? pdesc->vendor : "";
+      plugin.url = pdesc->url ? pdesc->url : "";
+      plugin.manual_url = pdesc->manual_url ? pdesc->manual_url : "";
+      plugin.support_url = pdesc->support_url ? pdesc->support_url : "";
+      plugin.description = pdesc->description ? pdesc->description : "";
       StringS features;
       if (pdesc->features)
         for (size_t ft = 0; pdesc->features[ft]; ft++)
           if (pdesc->features[ft][0])
             features.push_back (feature_canonify (pdesc->features[ft]));
-      descriptor->features = ":" + string_join (":", features) + ":";
-      infos.push_back (descriptor);
-      CDEBUG ("Plugin: %s %s %s (%s, %s)%s", descriptor->name, descriptor->version,
-              descriptor->vendor.empty() ? "" : "- " + descriptor->vendor,
-              descriptor->id, clapversion,
-              descriptor->features.empty() ? "" : ": " + descriptor->features);
+      plugin.features = ":" + string_join (":", features) + ":";
+      plugins.push_back (plugin);
     }
-  filehandle->close();
+  filehandle.close();
+}
+
+/// Scan `clapfile` in a child process, returns `false` if scanning crashed or hung.
+static bool
+scan_clap_file_isolated (const String &clapfile, ClapScanPluginS &plugins)
+{
+  const String exe = executable_path();
+  int fds[2] = { -1, -1 };
+  if (pipe2 (fds, O_CLOEXEC) < 0)
+    {
+      CDEBUG ("%s: pipe2: %s", clapfile, strerror (errno));
+      scan_clap_file (clapfile, plugins);
+      return true;
+    }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_adddup2 (&actions, fds[1], 1);
+  const char *argv[] = { exe.c_str(), "--clap-scan", clapfile.c_str(), nullptr };
+  pid_t pid = -1;
+  const int err = posix_spawn (&pid, exe.c_str(), &actions, nullptr, const_cast<char**> (argv), environ);
+  posix_spawn_file_actions_destroy (&actions);
+  close (fds[1]);
+  if (err)
+    {
+      close (fds[0]);
+      CDEBUG ("%s: posix_spawn: %s", exe, strerror (err));
+      scan_clap_file (clapfile, plugins);
+      return true;
+    }
+  // collect output until EOF or timeout
+  String output;
+  bool timedout = false;
+  const uint64 deadline = timestamp_realtime() + CLAP_SCAN_TIMEOUT;
+  for (;;)
+    {
+      const uint64 now = timestamp_realtime();
+      if (now >= deadline) {
+        timedout = true;
+        break;
+      }
+      struct pollfd pfd = { .fd = fds[0], .events = POLLIN, .revents = 0 };
+      const int r = poll (&pfd, 1, (deadline - now + 999) / 1000);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0) {
+        timedout = r == 0;
+        break;
+      }
+      char buffer[4096];
+      const ssize_t l = read (fds[0], buffer, sizeof (buffer));
+      if (l < 0 && errno == EINTR)
+        continue;
+      if (l <= 0)
+        break;  // EOF
+      output.append (buffer, l);
+    }
+  close (fds[0]);
+  if (timedout)
+    kill (pid, SIGKILL);
+  int status = 0;
+  while (waitpid (pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  const bool exited = WIFEXITED (status) && WEXITSTATUS (status) == 0;
+  if (timedout || !exited || !json_parse (output, plugins))
+    {
+      CDEBUG ("%s: scanning failed: %s", clapfile, timedout ? "timeout" :
+              WIFSIGNALED (status) ? strsignal (WTERMSIG (status)) : "exit status");
+      plugins.clear();
+      return false;
+    }
+  return true;
+}
+
+/// Validate cached entries against `list_clap_files()` and scan new or modified files.
+static void
+clap_scan_files (ClapScanEntryS &entries)
+{
+  const String clapversion = string_format ("%u.%u.%u", CLAP_VERSION.major, CLAP_VERSION.minor, CLAP_VERSION.revision);
+  ClapScanCache cache;
+  json_parse (Path::stringread (clap_scan_cache_path()), cache);
+  if (cache.clap_version != clapversion)
+    cache.entries.clear();
+  bool modified = false;
+  for (const String &clapfile : list_clap_files())
+    {
+      struct stat st = {};
+      if (stat (clapfile.c_str(), &st) < 0)
+        continue;
+      ClapScanEntry entry;
+      entry.path = clapfile;
+      entry.mtime = st.st_mtim.tv_sec * int64 (1000000000) + st.st_mtim.tv_nsec;
+      entry.size = st.st_size;
+      auto it = std::find_if (cache.entries.begin(), cache.entries.end(), [&entry] (const ClapScanEntry &e) {
+        return e.path == entry.path && e.mtime == entry.mtime && e.size == entry.size;
+      });
+      if (it != cache.entries.end()) {
+        entries.push_back (*it);
+        continue;
+      }
+      // moved or touched files are identified by contents
+      modified = true;
+      entry.hash = string_to_hex (blake3_hash_file (clapfile));
+      it = std::find_if (cache.entries.begin(), cache.entries.end(), [&entry] (const ClapScanEntry &e) {
+        return e.size == entry.size && e.hash == entry.hash && !entry.hash.empty();
+      });
+      if (it != cache.entries.end()) {
+        entry.blacklisted = it->blacklisted;
+        entry.plugins = it->plugins;
+      } else {
+        entry.blacklisted = !scan_clap_file_isolated (clapfile, entry.plugins);
+        if (entry.blacklisted)
+          printerr ("%s: ignoring CLAP file that crashed or hung during scanning\n", clapfile);
+      }
+      entries.push_back (entry);
+    }
+  modified |= entries.size() != cache.entries.size();
+  if (modified) {
+    cache.clap_version = clapversion;
+    cache.entries = entries;
+    if (!Path::stringwrite (clap_scan_cache_path(), json_stringify (cache, Writ::RELAXED) + "\n", true))
+      CDEBUG ("%s: failed to write: %s", clap_scan_cache_path(), strerror (errno));
+  }
+  CDEBUG ("%s: %u files, %s", __func__, entries.size(), modified ? "rescanned" : "cached");
+}
+
+/// Start scanning CLAP files in a background thread, collect_descriptors() picks up the results.
+void
+ClapPluginDescriptor::start_scanning ()
+{
+  return_unless (clap_scan_thread == nullptr);
+  clap_scan_thread = new std::thread ([] () {
+    this_thread_set_name ("AseClapScan");
+    clap_scan_files (clap_scan_entries);
+  });
 }
 
 const ClapPluginDescriptor::Collection&
 ClapPluginDescriptor::collect_descriptors ()
 {
   static Collection collection;
-  if (collection.empty()) {
-    for (const auto &clapfile : list_clap_files())
-      add_descriptor (clapfile, collection);
+  static bool collected = false;
+  if (!collected) {
+    start_scanning();
+    clap_scan_thread->join();
+    collected = true;
+    for (const ClapScanEntry &entry : clap_scan_entries) {
+      if (entry.blacklisted || entry.plugins.empty())
+        continue;
+      ClapFileHandle *filehandle = new ClapFileHandle (entry.path);
+      for (const ClapScanPlugin &plugin : entry.plugins) {
+        ClapPluginDescriptor *descriptor = new ClapPluginDescriptor (*filehandle);
+        descriptor->id = plugin.id;
+        descriptor->name = plugin.name;
+        descriptor->version = plugin.version;
+        descriptor->vendor = plugin.vendor;
+        descriptor->features = plugin.features;
+        descriptor->description = plugin.description;
+        descriptor->url = plugin.url;
+        descriptor->manual_url = plugin.manual_url;
+        descriptor->support_url = plugin.support_url;
+        collection.push_back (descriptor);
+        CDEBUG ("Plugin: %s %s %s (%s)%s", descriptor->name, descriptor->version,
+                descriptor->vendor.empty() ? "" : "- " + descriptor->vendor, descriptor->id,
+                descriptor->features.empty() ? "" : ": " + descriptor->features);
+      }
+    }
   }
   return collection;
 }
@@ -1898,6 +2388,15 @@ list_clap_files()
   return files;
 }
 
+/// Load `clapfile` and list its plugins as JSON, used by `--clap-scan` for crash isolated scanning.
+String
+clap_scan_probe (const String &clapfile)
+{
+  ClapScanPluginS plugins;
+  scan_clap_file (clapfile, plugins);
+  return json_stringify (plugins);
+}
+
 const char*
 clap_event_type_string (int etype)
 {
@@ -1998,6 +2497,16 @@ ClapPluginHandle::audio_processor_type()
   return clap_audio_wrapper_aseid;
 }
 
+/// Switch all activated plugins between CLAP_RENDER_OFFLINE and CLAP_RENDER_REALTIME.
+void
+ClapPluginHandle::set_render_offline (bool offline)
+{
+  assert_return (this_thread_is_ase());
+  clap_render_offline = offline;
+  for (ClapPluginHandleImpl *handle : active_handles)
+    handle->update_render_mode();
+}
+
 ClapPluginHandleP
 ClapPluginHandle::make_clap_handle (const ClapPluginDescriptor &descriptor, AudioProcessorP audio_processor)
 {
@@ -2007,3 +2516,54 @@ ClapPluginHandle::make_clap_handle (const ClapPluginDescriptor &descriptor, Audi
 }
 
 } // Ase
+
+// == Testing ==
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (clap_param_timing_test);
+static void
+clap_param_timing_test()
+{
+  auto param_event = [] (int64_t steady_time, clap_id param_id) {
+    ClapEventParam pevent = {};
+    pevent.header = { .size = sizeof (clap_event_param_value_t), .time = 0, .space_id = CLAP_CORE_EVENT_SPACE_ID,
+                      .type = CLAP_EVENT_PARAM_VALUE, .flags = 0 };
+    pevent.param_id = param_id;
+    pevent.steady_time = steady_time;
+    return pevent;
+  };
+  const ClapEventParam queue[] = { param_event (990, 1), param_event (1100, 2), param_event (1300, 3) };
+  ClapEventPage events (8);
+  ClapEventUnion *note = events.push();
+  note->header = { .size = sizeof (clap_event_note_t), .time = 100, .space_id = CLAP_CORE_EVENT_SPACE_ID,
+                   .type = CLAP_EVENT_NOTE_ON, .flags = 0 };
+  // block [1000,1256): stale event at frame 0, mid-block event at frame 100 ahead of the note
+  uint n = clap_merge_param_events (queue, 3, 1000, 256, events);
+  TCMP (n, ==, 2);
+  TCMP (events.size(), ==, 3);
+  TCMP (events[0].value.param_id, ==, 1);
+  TCMP (events[0].header.time, ==, 0);
+  TCMP (events[1].value.param_id, ==, 2);
+  TCMP (events[1].header.time, ==, 100);
+  TCMP (events[2].header.type, ==, CLAP_EVENT_NOTE_ON);
+  // event stamped beyond the block end is delivered in the next block
+  events.clear();
+  n = clap_merge_param_events (queue + 2, 1, 1256, 256, events);
+  TCMP (n, ==, 1);
+  TCMP (events[0].value.param_id, ==, 3);
+  TCMP (events[0].header.time, ==, 1300 - 1256);
+  // overflowing updates are reduced to the last value per parameter
+  ClapEventParamS pending = { param_event (10, 1), param_event (20, 2), param_event (30, 1), param_event (40, 3), param_event (50, 2) };
+  clap_coalesce_param_events (pending);
+  TCMP (pending.size(), ==, 3);
+  TCMP (pending[0].param_id, ==, 1);
+  TCMP (pending[0].steady_time, ==, 30);
+  TCMP (pending[1].param_id, ==, 3);
+  TCMP (pending[2].param_id, ==, 2);
+  TCMP (pending[2].steady_time, ==, 50);
+}
+
+} // Anon
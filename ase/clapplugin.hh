@@ -22,13 +22,13 @@ public:
   void                     close                () const;
   const clap_plugin_entry* entry                () const;
   ClapFileHandle&          file_handle          () const { return clapfile_; }
-  static void              add_descriptor       (const String &pluginpath, Collection &infos);
+  static void              start_scanning       ();
   static const Collection& collect_descriptors ();
 };
 
 // == ClapParamUpdate ==
 struct ClapParamUpdate {
-  int64_t  steady_time = 0; // unimplemented
+  int64_t  steady_time = 0; // AudioEngine::frame_counter() stamp, 0 means immediately
   clap_id  param_id = CLAP_INVALID_ID;
   double   value = NAN;
 };
@@ -87,11 +87,13 @@ public:
   virtual AudioProcessorP     audio_processor    () = 0;
   static ClapPluginHandleP    make_clap_handle   (const ClapPluginDescriptor &descriptor, AudioProcessorP audio_processor);
   static CString              audio_processor_type();
+  static void                 set_render_offline (bool offline);
   friend class ClapAudioProcessor;
 };
 
 // == CLAP utilities ==
 StringS     list_clap_files        ();
+String      clap_scan_probe        (const String &clapfile);
 const char* clap_event_type_string (int etype);
 String      clap_event_to_string   (const clap_event_note_t *enote);
 DeviceInfo  clap_device_info       (const ClapPluginDescriptor &descriptor);
@@ -1,6 +1,7 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 #include "combo.hh"
 #include "server.hh"
+#include "monitor.hh"
 #include "internal.hh"
 
 #define PDEBUG(...)     Ase::debug ("combo", __VA_ARGS__)
@@ -176,13 +177,18 @@ AudioChain::schedule_children()
 {
   last_output_ = nullptr;
   uint level = schedule_processor (*inlet_);
+  uint chain_latency = 0;
   for (auto procp : processors_)
     {
       const uint l = schedule_processor (*procp);
       level = std::max (level, l);
       if (procp->n_obuses())
-        last_output_ = procp.get();
+        {
+          last_output_ = procp.get();
+          chain_latency += procp->latency(); // children are in series, delays add up
+        }
     }
+  set_latency (chain_latency);
   // last_output_ is only valid during render()
   return level;
 }
@@ -217,10 +223,24 @@ AudioChain::render (uint n_frames)
               (*probes)[c].dbspl = db_spl;
             }
         }
+      for (const auto &tap : monitors_)
+        if (tap->ochannel == ssize_t (c))
+          tap->process (last_output_ ? ofloats (OUT1, c) : nullptr, n_frames);
     }
   // TODO: do we need to assign oblock when no children are present?
 }
 
+/// Feed the chain input from the main output of `iproc`, disconnects for `nullptr`.
+void
+AudioChain::set_audio_input (AudioProcessor *iproc)
+{
+  const IBusId IN1 = IBusId (1);
+  if (iproc)
+    connect (IN1, *iproc, OUT1);
+  else
+    disconnect (IN1);
+}
+
 /// Reconnect AudioChain child processors at start and after.
 void
 AudioChain::reconnect (size_t index, bool insertion)
@@ -278,6 +298,35 @@ AudioChain::run_probes (bool enable)
   return probes_enabled_ ? probes_ : nullptr;
 }
 
+/// Add a MonitorTap to analyze an output channel, called from the main thread.
+void
+AudioChain::add_monitor (std::shared_ptr<MonitorTap> tap)
+{
+  assert_return (tap != nullptr);
+  monitors_ml_.push_back (tap);
+  update_monitors_ml();
+}
+
+/// Remove a MonitorTap, called from the main thread.
+void
+AudioChain::del_monitor (std::shared_ptr<MonitorTap> tap)
+{
+  const bool foundtap = Aux::erase_first (monitors_ml_, [tap] (const auto &t) { return t == tap; });
+  assert_return (foundtap);
+  update_monitors_ml();
+}
+
+/// Swap a copy of `monitors_ml_` into the engine thread, the previous taps are released with the job in the main thread.
+void
+AudioChain::update_monitors_ml ()
+{
+  AudioChainP chain = shared_ptr_cast<AudioChain> (this);
+  assert_return (chain);
+  engine().async_jobs += [chain, taps = monitors_ml_] () mutable {
+    chain->monitors_.swap (taps);
+  };
+}
+
 static const auto audio_chain_id = register_audio_processor<AudioChain>();
 
 } // Ase
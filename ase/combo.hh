@@ -6,6 +6,8 @@
 
 namespace Ase {
 
+class MonitorTap;
+
 class AudioCombo : public AudioProcessor, protected ProcessorManager {
 protected:
   AudioProcessorS  processors_;
@@ -42,11 +44,18 @@ public:
   struct Probe { float dbspl = -192; };
   using ProbeArray = std::array<Probe,2>;
   ProbeArray* run_probes     (bool enable);
+  void        add_monitor    (std::shared_ptr<MonitorTap> tap);
+  void        del_monitor    (std::shared_ptr<MonitorTap> tap);
+  void        set_audio_input (AudioProcessor *iproc);
   static void static_info    (AudioProcessorInfo &info);
 private:
   ProbeArray *probes_ = nullptr;
   bool        probes_enabled_ = false;
   FastMemory::Block probe_block_;
+  using MonitorTapS = std::vector<std::shared_ptr<MonitorTap>>;
+  MonitorTapS monitors_;        // accessed by the engine thread
+  MonitorTapS monitors_ml_;     // accessed by the main thread
+  void        update_monitors_ml ();
 };
 
 } // Ase
@@ -6,22 +6,326 @@ namespace Ase {
 
 float const_float_zeros[AUDIO_BLOCK_FLOAT_ZEROS_SIZE] = { 0, /*...*/ };
 
-float
-square_sum (uint n_values, const float *ivalues)
+// == SIMD Kernels ==
+/* Kernels are written with GCC vector extensions of W floats. Always inlined
+ * into functions compiled for a specific target, they turn into SSE, AVX2,
+ * AVX-512 or NEON code. The best variant is selected at runtime.
+ */
+#define ALWAYS_INLINE   __attribute__ ((always_inline)) inline
+
+template<int W>
+struct SimdVec {
+  typedef float   F   __attribute__ ((vector_size (W * sizeof (float)), aligned (4)));
+  typedef int32_t I32 __attribute__ ((vector_size (W * sizeof (int32_t)), aligned (4)));
+  typedef int16_t I16 __attribute__ ((vector_size (W * sizeof (int16_t)), aligned (2)));
+};
+
+template<int W, class V> static ALWAYS_INLINE V
+simd_load (const void *p)
+{
+  V v;
+  __builtin_memcpy (&v, p, sizeof (V));
+  return v;
+}
+
+template<int W, class V> static ALWAYS_INLINE void
+simd_store (void *p, const V &v)
+{
+  __builtin_memcpy (p, &v, sizeof (V));
+}
+
+template<int W> static ALWAYS_INLINE void
+simd_zip (const typename SimdVec<W>::F &a, const typename SimdVec<W>::F &b,
+          typename SimdVec<W>::F &lo, typename SimdVec<W>::F &hi)
+{
+  if constexpr (W == 4)
+    {
+      lo = __builtin_shufflevector (a, b, 0, 4, 1, 5);
+      hi = __builtin_shufflevector (a, b, 2, 6, 3, 7);
+    }
+  else if constexpr (W == 8)
+    {
+      lo = __builtin_shufflevector (a, b, 0, 8, 1, 9, 2, 10, 3, 11);
+      hi = __builtin_shufflevector (a, b, 4, 12, 5, 13, 6, 14, 7, 15);
+    }
+  else if constexpr (W == 16)
+    {
+      lo = __builtin_shufflevector (a, b, 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+      hi = __builtin_shufflevector (a, b, 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    }
+}
+
+template<int W, bool ADDING> static ALWAYS_INLINE void
+interleave2_kernel (size_t n_frames, float *dst, const float *src0, const float *src1)
+{
+  using F = typename SimdVec<W>::F;
+  size_t i = 0;
+  for (; i + W <= n_frames; i += W)
+    {
+      F lo, hi;
+      simd_zip<W> (simd_load<W,F> (src0 + i), simd_load<W,F> (src1 + i), lo, hi);
+      if constexpr (ADDING)
+        {
+          lo += simd_load<W,F> (dst + 2 * i);
+          hi += simd_load<W,F> (dst + 2 * i + W);
+        }
+      simd_store<W> (dst + 2 * i, lo);
+      simd_store<W> (dst + 2 * i + W, hi);
+    }
+  for (; i < n_frames; i++)
+    if constexpr (ADDING)
+      {
+        dst[2 * i] += src0[i];
+        dst[2 * i + 1] += src1[i];
+      }
+    else
+      {
+        dst[2 * i] = src0[i];
+        dst[2 * i + 1] = src1[i];
+      }
+}
+
+template<int W> static ALWAYS_INLINE void
+gain_mix_kernel (size_t n, float *dst, const float *src, float gain)
+{
+  using F = typename SimdVec<W>::F;
+  size_t i = 0;
+  for (; i + W <= n; i += W)
+    simd_store<W> (dst + i, simd_load<W,F> (dst + i) + simd_load<W,F> (src + i) * gain);
+  for (; i < n; i++)
+    dst[i] += src[i] * gain;
+}
+
+enum SquareOp { SQUARE_SUM, SQUARE_MAX, ABS_MAX };
+
+template<int W, SquareOp OP> static ALWAYS_INLINE float
+scan_kernel (uint n_values, const float *ivalues)
 {
+  using F = typename SimdVec<W>::F;
+  F vaccu = {};
+  uint i = 0;
+  for (; i + W <= n_values; i += W)
+    {
+      const F v = simd_load<W,F> (ivalues + i);
+      if constexpr (OP == SQUARE_SUM)
+        vaccu += v * v;
+      else if constexpr (OP == SQUARE_MAX)
+        vaccu = vaccu > v * v ? vaccu : v * v;
+      else // ABS_MAX
+        {
+          const F a = v > -v ? v : -v;
+          vaccu = vaccu > a ? vaccu : a;
+        }
+    }
   float accu = 0.0;
-  for (uint i = 0; i < n_values; i++)
-    accu += ivalues[i] * ivalues[i];
+  for (int j = 0; j < W; j++)
+    accu = OP == SQUARE_SUM ? accu + vaccu[j] : std::max (accu, vaccu[j]);
+  for (; i < n_values; i++)
+    if constexpr (OP == SQUARE_SUM)
+      accu += ivalues[i] * ivalues[i];
+    else if constexpr (OP == SQUARE_MAX)
+      accu = std::max (accu, ivalues[i] * ivalues[i]);
+    else // ABS_MAX
+      accu = std::max (accu, std::abs (ivalues[i]));
   return accu;
 }
 
+template<int W, class D, int BITS> static ALWAYS_INLINE void
+clip_kernel (size_t n, const float *src, D *dst)
+{
+  using F = typename SimdVec<W>::F;
+  using I32 = typename SimdVec<W>::I32;
+  constexpr float scale = 1ll << (BITS - 1);
+  constexpr float vmax = BITS > 24 ? 0.99999994F : 0.99999990F; // max float below 1.0 that truncates to INT_MAX
+  size_t i = 0;
+  for (; i + W <= n; i += W)
+    {
+      F v = simd_load<W,F> (src + i);
+      v = v < -1.0F ? -1.0F : v;
+      v = v > vmax ? vmax : v;
+      const I32 iv = __builtin_convertvector (v * scale, I32);
+      if constexpr (sizeof (D) == 2)
+        simd_store<W> (dst + i, __builtin_convertvector (iv, typename SimdVec<W>::I16));
+      else
+        simd_store<W> (dst + i, iv);
+    }
+  for (; i < n; i++)
+    dst[i] = std::min (vmax, std::max (src[i], -1.0F)) * scale;
+}
+
+struct SimdKernels {
+  const char *isa;
+  void  (*interleave2)         (size_t, float*, const float*, const float*);
+  void  (*interleave2_add)     (size_t, float*, const float*, const float*);
+  void  (*gain_mix)            (size_t, float*, const float*, float);
+  float (*square_sum)          (uint, const float*);
+  float (*square_max)          (uint, const float*);
+  float (*abs_max)             (uint, const float*);
+  void  (*float_to_int16_clip) (size_t, const float*, int16_t*);
+  void  (*float_to_int24_clip) (size_t, const float*, int32_t*);
+  void  (*float_to_int32_clip) (size_t, const float*, int32_t*);
+};
+
+#define SIMD_KERNELS(NAME, W, ...)                                      \
+  struct NAME {                                                         \
+    __VA_ARGS__ static void interleave2 (size_t n, float *d, const float *s0, const float *s1) \
+    { interleave2_kernel<W,false> (n, d, s0, s1); }                     \
+    __VA_ARGS__ static void interleave2_add (size_t n, float *d, const float *s0, const float *s1) \
+    { interleave2_kernel<W,true> (n, d, s0, s1); }                      \
+    __VA_ARGS__ static void gain_mix (size_t n, float *d, const float *s, float g) \
+    { gain_mix_kernel<W> (n, d, s, g); }                                \
+    __VA_ARGS__ static float square_sum (uint n, const float *v)        \
+    { return scan_kernel<W,SQUARE_SUM> (n, v); }                        \
+    __VA_ARGS__ static float square_max (uint n, const float *v)        \
+    { return scan_kernel<W,SQUARE_MAX> (n, v); }                        \
+    __VA_ARGS__ static float abs_max (uint n, const float *v)           \
+    { return scan_kernel<W,ABS_MAX> (n, v); }                           \
+    __VA_ARGS__ static void float_to_int16_clip (size_t n, const float *s, int16_t *d) \
+    { clip_kernel<W,int16_t,16> (n, s, d); }                            \
+    __VA_ARGS__ static void float_to_int24_clip (size_t n, const float *s, int32_t *d) \
+    { clip_kernel<W,int32_t,24> (n, s, d); }                            \
+    __VA_ARGS__ static void float_to_int32_clip (size_t n, const float *s, int32_t *d) \
+    { clip_kernel<W,int32_t,32> (n, s, d); }                            \
+    static constexpr SimdKernels kernels = {                            \
+      #NAME, interleave2, interleave2_add, gain_mix, square_sum, square_max, abs_max, \
+      float_to_int16_clip, float_to_int24_clip, float_to_int32_clip,    \
+    };                                                                  \
+  }
+
+// SSE2 on x86-64, NEON on aarch64, generic code elsewhere
+SIMD_KERNELS (Vec128, 4);
+#if defined __x86_64__
+SIMD_KERNELS (AVX2, 8, __attribute__ ((target ("avx2,fma"))));
+SIMD_KERNELS (AVX512, 16, __attribute__ ((target ("avx512f,avx512bw"))));
+#endif
+
+static const SimdKernels&
+simd_kernels ()
+{
+  static const SimdKernels &kernels = [] () -> const SimdKernels& {
+#if defined __x86_64__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512bw"))
+      return AVX512::kernels;
+    if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma"))
+      return AVX2::kernels;
+#endif
+    return Vec128::kernels;
+  } ();
+  return kernels;
+}
+
+const char*
+simd_kernel_isa ()
+{
+  return simd_kernels().isa;
+}
+
+float
+square_sum (uint n_values, const float *ivalues)
+{
+  return simd_kernels().square_sum (n_values, ivalues);
+}
+
 float
 square_max (uint n_values, const float *ivalues)
 {
-  float accu = 0.0;
-  for (uint i = 0; i < n_values; i++)
-    accu = std::max (accu, ivalues[i] * ivalues[i]);
-  return accu;
+  return simd_kernels().square_max (n_values, ivalues);
+}
+
+float
+abs_max (uint n_values, const float *ivalues)
+{
+  return simd_kernels().abs_max (n_values, ivalues);
+}
+
+void
+interleave2 (size_t n_frames, float *dst, const float *src0, const float *src1)
+{
+  simd_kernels().interleave2 (n_frames, dst, src0, src1);
+}
+
+void
+interleave2_add (size_t n_frames, float *dst, const float *src0, const float *src1)
+{
+  simd_kernels().interleave2_add (n_frames, dst, src0, src1);
+}
+
+void
+gain_mix (size_t n, float *dst, const float *src, float gain)
+{
+  simd_kernels().gain_mix (n, dst, src, gain);
+}
+
+void
+float_to_int16_clip (size_t n, const float *src, int16_t *dst)
+{
+  simd_kernels().float_to_int16_clip (n, src, dst);
+}
+
+void
+float_to_int24_clip (size_t n, const float *src, int32_t *dst)
+{
+  simd_kernels().float_to_int24_clip (n, src, dst);
+}
+
+void
+float_to_int32_clip (size_t n, const float *src, int32_t *dst)
+{
+  simd_kernels().float_to_int32_clip (n, src, dst);
 }
 
 } // Ase
+
+// == Testing ==
+#include "testing.hh"
+
+namespace { // Anon
+using namespace Ase;
+
+TEST_INTEGRITY (datautils_simd_tests);
+static void
+datautils_simd_tests()
+{
+  constexpr size_t N = 67; // exercise vector loops and scalar tails
+  float a[N], b[N], il[2 * N];
+  for (size_t i = 0; i < N; i++)
+    {
+      a[i] = (i % 9) * 0.25 - 1.0;
+      b[i] = 1.5 - (i % 7) * 0.5;
+    }
+  interleave2 (N, il, a, b);
+  for (size_t i = 0; i < N; i++)
+    TASSERT (il[2 * i] == a[i] && il[2 * i + 1] == b[i]);
+  interleave2_add (N, il, b, a);
+  for (size_t i = 0; i < N; i++)
+    TASSERT (il[2 * i] == a[i] + b[i] && il[2 * i + 1] == b[i] + a[i]);
+  float m[N];
+  floatfill (m, 1.0, N);
+  gain_mix (N, m, a, 0.5);
+  float ssum = 0, smax = 0, amax = 0;
+  for (size_t i = 0; i < N; i++)
+    {
+      TASSERT (m[i] == 1.0F + a[i] * 0.5F);
+      ssum += b[i] * b[i];
+      smax = std::max (smax, b[i] * b[i]);
+      amax = std::max (amax, std::abs (b[i]));
+    }
+  TCMP (square_max (N, b), ==, smax);
+  TCMP (abs_max (N, b), ==, amax);
+  TCMP (std::abs (square_sum (N, b) - ssum), <, 0.001);
+  int16_t i16[N];
+  int32_t i24[N], i32[N];
+  float_to_int16_clip (N, b, i16);
+  float_to_int24_clip (N, b, i24);
+  float_to_int32_clip (N, b, i32);
+  for (size_t i = 0; i < N; i++)
+    {
+      const float v = std::min (0.99999990F, std::max (b[i], -1.0F));
+      TCMP (i16[i], ==, int16_t (v * 32768.F));
+      TCMP (i24[i], ==, int32_t (v * 8388608.F));
+      TCMP (i32[i], ==, int32_t (std::min (0.99999994F, std::max (b[i], -1.0F)) * 2147483648.F));
+    }
+}
+
+} // Anon
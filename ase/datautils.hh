@@ -18,6 +18,30 @@ float square_sum (uint n_values, const float *ivalues);
 /// Find the maximum suqared value in a block of floats.
 float square_max (uint n_values, const float *ivalues);
 
+/// Find the maximum absolute value in a block of floats.
+float abs_max (uint n_values, const float *ivalues);
+
+/// Interleave two channels into `dst`, which holds 2 * `n_frames` values.
+void interleave2 (size_t n_frames, float *dst, const float *src0, const float *src1);
+
+/// Add two channels to the interleaved values in `dst`.
+void interleave2_add (size_t n_frames, float *dst, const float *src0, const float *src1);
+
+/// Add `n` values of `src` multiplied by `gain` to `dst`.
+void gain_mix (size_t n, float *dst, const float *src, float gain);
+
+/// Convert float to 16bit samples with clipping.
+void float_to_int16_clip (size_t n, const float *src, int16_t *dst);
+
+/// Convert float to 24bit samples in 32bit containers with clipping.
+void float_to_int24_clip (size_t n, const float *src, int32_t *dst);
+
+/// Convert float to 32bit samples with clipping.
+void float_to_int32_clip (size_t n, const float *src, int32_t *dst);
+
+/// Name of the instruction set selected at runtime for the vectorized block functions.
+const char* simd_kernel_isa ();
+
 // Convert integer to float samples.
 template<class S, class D> inline void convert_samples (size_t n, S *src, D *dst, uint16 byte_order);
 
@@ -65,13 +89,7 @@ convert_clip_samples (size_t n, const float *src, int16_t *dst, uint16 byte_orde
 {
   ASE_ASSERT_RETURN (__BYTE_ORDER__ == byte_order); // swapping __BYTE_ORDER__ not implemented
   static_assert (int16_t (0.99999990F * 32768.F) == 32767);
-  const auto bound = src + n;
-  while (src < bound)
-    {
-      auto v = *src++;
-      v = std::min (0.99999990F, std::max (v, -1.0F));
-      *dst++ = v * 32768.;
-    }
+  float_to_int16_clip (n, src, dst);
 }
 
 } // Ase
@@ -19,6 +19,7 @@ static constexpr float    F32MAX = 3.40282347e+38;            // 7f7fffff, 2^128
 static constexpr double   M52MAX = 9007199254740992;          // 2^(1+52); IEEE-754 Double Mantissa maximum
 static constexpr double   D64MAX = 1.7976931348623157e+308;   // 0x7fefffff ffffffff, IEEE-754 Double Maximum
 static constexpr int64_t  AUDIO_BLOCK_MAX_RENDER_SIZE = 2048;
+static constexpr int64_t  AUDIO_BLOCK_MIN_RENDER_SIZE = 8;    // render sizes are multiples of 8
 
 // == Forward Declarations ==
 enum class Error;
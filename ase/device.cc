@@ -95,6 +95,14 @@ Device::remove_self ()
     device->remove_device (*this);
 }
 
+TelemetryFieldS
+Device::render_telemetry ()
+{
+  AudioProcessorP proc = _audio_processor();
+  return_unless (proc, {});
+  return proc->render_telemetry();
+}
+
 Track*
 Device::_track () const
 {
@@ -2,9 +2,13 @@
 #include "driver.hh"
 #include "datautils.hh"
 #include "platform.hh"
+#include "utils.hh"
+#include "atomics.hh"
 #include "internal.hh"
+#include "testing.hh"
 #include <limits.h> // LONG_MAX
 #include <atomic>
+#include <thread>
 #include <cmath>
 
 #define PDEBUG(...)             Ase::debug ("alsa", "PCM: " __VA_ARGS__)
@@ -343,6 +347,48 @@ list_alsa_drivers (Driver::EntryVec &entries)
 }
 
 // == AlsaPcmDriver ==
+/// Sample formats in order of preference, float avoids conversions, 32/24 bit retain resolution.
+static constexpr snd_pcm_format_t alsa_pcm_formats[] = {
+  SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_LE, SND_PCM_FORMAT_S16_LE,
+};
+
+/// Convert `n` interleaved `floats` into `format` samples at `dest`.
+static void
+alsa_samples_from_float (snd_pcm_format_t format, size_t n, const float *floats, void *dest)
+{
+  switch (format)
+    {
+    case SND_PCM_FORMAT_FLOAT_LE:       fast_copy (n, (float*) dest, floats);                   break;
+    case SND_PCM_FORMAT_S32_LE:         float_to_int32_clip (n, floats, (int32_t*) dest);       break;
+    case SND_PCM_FORMAT_S24_LE:         float_to_int24_clip (n, floats, (int32_t*) dest);       break;
+    default:                            float_to_int16_clip (n, floats, (int16_t*) dest);       break;
+    }
+}
+
+/// Convert `n` interleaved `format` samples at `src` into `floats`.
+static void
+alsa_samples_to_float (snd_pcm_format_t format, size_t n, const void *src, float *floats)
+{
+  const int32_t *i32 = (const int32_t*) src;
+  switch (format)
+    {
+    case SND_PCM_FORMAT_FLOAT_LE:
+      fast_copy (n, floats, (const float*) src);
+      break;
+    case SND_PCM_FORMAT_S32_LE:
+      for (size_t i = 0; i < n; i++)
+        floats[i] = i32[i] * (1.0 / 2147483648.0);
+      break;
+    case SND_PCM_FORMAT_S24_LE:         // sign extend the lower 24 bits
+      for (size_t i = 0; i < n; i++)
+        floats[i] = (int32_t (uint32_t (i32[i]) << 8) >> 8) * (1.0 / 8388608.0);
+      break;
+    default:
+      convert_samples (n, (const int16_t*) src, floats, __BYTE_ORDER__);
+      break;
+    }
+}
+
 class AlsaPcmDriver : public PcmDriver {
   snd_pcm_t    *read_handle_ = nullptr;
   snd_pcm_t    *write_handle_ = nullptr;
@@ -350,7 +396,9 @@ class AlsaPcmDriver : public PcmDriver {
   uint          n_channels_ = 0;
   uint          n_periods_ = 0;
   int           period_size_ = 0;       // count in frames
-  int16        *period_buffer_ = nullptr;
+  char         *period_buffer_ = nullptr; // used for non-mmap IO
+  snd_pcm_format_t rformat_ = SND_PCM_FORMAT_S16_LE, wformat_ = SND_PCM_FORMAT_S16_LE;
+  bool          rmmap_ = false, wmmap_ = false;
   uint          read_write_count_ = 0;
   String        alsadev_;
 public:
@@ -437,10 +485,10 @@ public:
     Error error = !aerror ? Error::NONE : ase_error_from_errno (-aerror, Error::FILE_OPEN_FAILED);
     uint rh_freq = config.mix_freq, rh_n_periods = 2, rh_period_size = period_size;
     if (!aerror && read_handle_)
-      error = alsa_device_setup (read_handle_, config.latency_ms, &rh_freq, &rh_n_periods, &rh_period_size);
+      error = alsa_device_setup (read_handle_, config.latency_ms, &rh_freq, &rh_n_periods, &rh_period_size, &rformat_, &rmmap_);
     uint wh_freq = config.mix_freq, wh_n_periods = 2, wh_period_size = period_size;
     if (!aerror && write_handle_)
-      error = alsa_device_setup (write_handle_, config.latency_ms, &wh_freq, &wh_n_periods, &wh_period_size);
+      error = alsa_device_setup (write_handle_, config.latency_ms, &wh_freq, &wh_n_periods, &wh_period_size, &wformat_, &wmmap_);
     // check duplex
     if (!error && read_handle_ && write_handle_)
       {
@@ -463,7 +511,7 @@ public:
     // finish opening or shutdown
     if (!error)
       {
-        period_buffer_ = new int16[period_size_ * n_channels_];
+        period_buffer_ = new char[period_size_ * n_channels_ * sizeof (float)]; // fits all alsa_pcm_formats
         flags_ |= Flags::OPENED;
       }
     else
@@ -481,7 +529,8 @@ public:
     return error;
   }
   Error
-  alsa_device_setup (snd_pcm_t *phandle, uint latency_ms, uint *mix_freq, uint *n_periodsp, uint *period_sizep)
+  alsa_device_setup (snd_pcm_t *phandle, uint latency_ms, uint *mix_freq, uint *n_periodsp, uint *period_sizep,
+                     snd_pcm_format_t *formatp, bool *mmapp)
   {
     // turn on blocking behaviour since we may end up in read() with an unfilled buffer
     if (int aerror = snd_pcm_nonblock (phandle, 0); aerror < 0)
@@ -492,10 +541,23 @@ public:
       return_error ("snd_pcm_hw_params_any", aerror, FILE_OPEN_FAILED);
     if (int aerror = snd_pcm_hw_params_set_channels (phandle, hparams, n_channels_); aerror < 0)
       return_error ("snd_pcm_hw_params_set_channels", aerror, DEVICE_CHANNELS);
-    if (int aerror = snd_pcm_hw_params_set_access (phandle, hparams, SND_PCM_ACCESS_RW_INTERLEAVED); aerror < 0)
+    // prefer mmap access to convert directly into the DMA area, saving a copy per period
+    const bool mmap = snd_pcm_hw_params_test_access (phandle, hparams, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+    if (int aerror = snd_pcm_hw_params_set_access (phandle, hparams, mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED); aerror < 0)
       return_error ("snd_pcm_hw_params_set_access", aerror, DEVICE_FORMAT);
-    if (int aerror = snd_pcm_hw_params_set_format (phandle, hparams, SND_PCM_FORMAT_S16_LE); aerror < 0)
+    // prefer native float or high resolution formats
+    snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
+    for (snd_pcm_format_t f : alsa_pcm_formats)
+      if (snd_pcm_hw_params_test_format (phandle, hparams, f) == 0)
+        {
+          format = f;
+          break;
+        }
+    if (format == SND_PCM_FORMAT_UNKNOWN)
+      return_error ("snd_pcm_hw_params_test_format", -EINVAL, DEVICE_FORMAT);
+    if (int aerror = snd_pcm_hw_params_set_format (phandle, hparams, format); aerror < 0)
       return_error ("snd_pcm_hw_params_set_format", aerror, DEVICE_FORMAT);
+    PDEBUG ("SETUP: %s: access: %s format: %s", alsadev_, mmap ? "MMAP_INTERLEAVED" : "RW_INTERLEAVED", snd_pcm_format_name (format));
     // sample_rate
     uint rate = *mix_freq;
     if (int aerror = snd_pcm_hw_params_set_rate (phandle, hparams, rate, 0); aerror < 0)
@@ -565,6 +627,8 @@ public:
     *mix_freq = rate;
     *n_periodsp = nperiods;
     *period_sizep = period_size;
+    *formatp = format;
+    *mmapp = mmap;
     PDEBUG ("SETUP: %s: OPEN: r=%d w=%d n_channels=%d sample_freq=%d nperiods=%u period=%u (%u) bufsz=%u",
             alsadev_, phandle == read_handle_, phandle == write_handle_,
             n_channels_, *mix_freq, *n_periodsp, *period_sizep,
@@ -592,17 +656,21 @@ public:
     // fill playback buffer with silence
     if (write_handle_)
       {
-        const size_t needed_zeros = period_size_ / 2; // sizeof (int16) / sizeof (float)
+        const size_t needed_zeros = period_size_ * n_channels_;
         assert_return (needed_zeros <= AUDIO_BLOCK_FLOAT_ZEROS_SIZE);
         const float *zeros = const_float_zeros;
         for (size_t i = 0; i < n_periods_; i++)
-          {
-            int n;
-            do
-              n = snd_pcm_writei (write_handle_, zeros, period_size_);
-            while (n == -EAGAIN); // retry on signals
-            // printerr ("%s: written=%d, left: %d / %d\n", __func__, n, snd_pcm_avail (write_handle_), n_periods_ * period_size_);
-          }
+          for (int n_left = period_size_; n_left > 0;)
+            {
+              int n;
+              do
+                n = write_frames (zeros, n_left); // mmap writes may be partial at buffer wrap around
+              while (n == -EAGAIN); // retry on signals
+              if (n <= 0)
+                break;
+              n_left -= n;
+              // printerr ("%s: written=%d, left: %d / %d\n", __func__, n, snd_pcm_avail (write_handle_), n_periods_ * period_size_);
+            }
       }
     silence_error_handler--;
   }
@@ -675,7 +743,7 @@ public:
     read_write_count_ += 1;
     do
       {
-        ssize_t n_frames = snd_pcm_readi (read_handle_, period_buffer_, n_left);
+        ssize_t n_frames = read_frames (dest, n_left);
         if (n_frames < 0) // errors during read, could be underrun (-EPIPE)
           {
             PDEBUG ("READ: %s: read() error: %s", alsadev_, snd_strerror (n_frames));
@@ -683,14 +751,11 @@ public:
             snd_pcm_prepare (read_handle_);     // force retrigger
             silence_error_handler--;
             n_frames = n_left;
-            const size_t frame_size = n_channels_ * sizeof (period_buffer_[0]);
-            memset (period_buffer_, 0, n_frames * frame_size);
+            if (dest)
+              floatfill (dest, 0.0, n_frames * n_channels_);
           }
         if (dest) // ignore dummy reads()
-          {
-            convert_samples (n_frames * n_channels_, const_cast<const int16_t*> (period_buffer_), dest, __BYTE_ORDER__);
-            dest += n_frames * n_channels_;
-          }
+          dest += n_frames * n_channels_;
         n_left -= n_frames;
       }
     while (n_left);
@@ -713,10 +778,7 @@ public:
     size_t n_left = period_size_;       // in frames
     while (n_left)
       {
-        convert_clip_samples (n_left * n_channels_, floats, period_buffer_, __BYTE_ORDER__);
-        floats += n_left * n_channels_;
-        ssize_t n = 0;                  // in frames
-        n = snd_pcm_writei (write_handle_, period_buffer_, n_left);
+        const ssize_t n = write_frames (floats, n_left); // in frames
         if (n < 0)                      // errors during write, could be overrun (-EPIPE)
           {
             PDEBUG ("WRITE: %s: write() error: %s", alsadev_, snd_strerror (n));
@@ -725,9 +787,74 @@ public:
             silence_error_handler--;
             return;
           }
+        floats += n * n_channels_;
         n_left -= n;
       }
   }
+  /// Wait until `handle` has space or data for a transfer, returns available frames or error.
+  snd_pcm_sframes_t
+  mmap_avail (snd_pcm_t *handle)
+  {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update (handle);
+    if (avail == 0)
+      {
+        if (snd_pcm_state (handle) == SND_PCM_STATE_PREPARED)
+          snd_pcm_start (handle);       // mmap transfers need explicit starts for capture
+        if (int aerror = snd_pcm_wait (handle, 1000); aerror < 0)
+          return aerror;
+        avail = snd_pcm_avail_update (handle);
+      }
+    return avail;
+  }
+  /// Write up to `n_frames` of interleaved `floats`, returns number of frames written or error.
+  snd_pcm_sframes_t
+  write_frames (const float *floats, snd_pcm_uframes_t n_frames)
+  {
+    if (!wmmap_)
+      {
+        alsa_samples_from_float (wformat_, n_frames * n_channels_, floats, period_buffer_);
+        return snd_pcm_writei (write_handle_, period_buffer_, n_frames);
+      }
+    // convert into the DMA area, this saves a copy per period
+    const snd_pcm_sframes_t avail = mmap_avail (write_handle_);
+    if (avail < 0)
+      return avail;
+    const snd_pcm_channel_area_t *areas = nullptr;
+    snd_pcm_uframes_t offset = 0, frames = n_frames;
+    if (int aerror = snd_pcm_mmap_begin (write_handle_, &areas, &offset, &frames); aerror < 0)
+      return aerror;
+    char *dma = (char*) areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+    alsa_samples_from_float (wformat_, frames * n_channels_, floats, dma);
+    const snd_pcm_sframes_t n = snd_pcm_mmap_commit (write_handle_, offset, frames);
+    if (n >= 0 && snd_pcm_state (write_handle_) == SND_PCM_STATE_PREPARED &&
+        snd_pcm_avail_update (write_handle_) < period_size_)
+      snd_pcm_start (write_handle_);    // buffer is filled, mmap does not honor start_threshold
+    return n >= 0 && snd_pcm_uframes_t (n) != frames ? -EPIPE : n;
+  }
+  /// Read up to `n_frames` into interleaved `floats` (may be nullptr), returns number of frames read or error.
+  snd_pcm_sframes_t
+  read_frames (float *floats, snd_pcm_uframes_t n_frames)
+  {
+    if (!rmmap_)
+      {
+        const snd_pcm_sframes_t n = snd_pcm_readi (read_handle_, period_buffer_, n_frames);
+        if (n > 0 && floats)
+          alsa_samples_to_float (rformat_, n * n_channels_, period_buffer_, floats);
+        return n;
+      }
+    const snd_pcm_sframes_t avail = mmap_avail (read_handle_);
+    if (avail < 0)
+      return avail;
+    const snd_pcm_channel_area_t *areas = nullptr;
+    snd_pcm_uframes_t offset = 0, frames = n_frames;
+    if (int aerror = snd_pcm_mmap_begin (read_handle_, &areas, &offset, &frames); aerror < 0)
+      return aerror;
+    const char *dma = (const char*) areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+    if (floats)
+      alsa_samples_to_float (rformat_, frames * n_channels_, dma, floats);
+    const snd_pcm_sframes_t n = snd_pcm_mmap_commit (read_handle_, offset, frames);
+    return n >= 0 && snd_pcm_uframes_t (n) != frames ? -EPIPE : n;
+  }
 };
 
 static const String alsa_pcm_driverid = PcmDriver::register_driver ("alsa",
@@ -1145,7 +1272,7 @@ public:
     return snd_seq_event_input_pending (seq_, pull_fifo) > 0;
   }
   uint
-  fetch_events (MidiEventOutput &estream, double samplerate) override
+  fetch_events (MidiEventOutput &estream, double samplerate, uint n_frames) override
   {
     assert_return (!!evparser_, 0);
     const size_t old_size = estream.size();
@@ -1156,17 +1283,20 @@ public:
       return (channel + 1) * 128 + note;
     };
     bool must_sort = false;
+    // with a fixed latency of one block, events received during the last n_frames
+    // map to sample accurate positions within the block to be rendered
+    const int64_t max_frame = std::max (1u, n_frames) - 1;
     const auto add = [&] (MidiEventOutput &estream, const snd_seq_event_t *ev, const MidiEvent &event) {
       const double t = ev->time.time.tv_sec + 1e-9 * ev->time.time.tv_nsec;
-      const double diff = t - now;
-      int64_t frames = diff * samplerate;
+      const double diff = t - now;                      // <= 0 for received events
+      int64_t frames = n_frames + int64_t (diff * samplerate);
       if (event.type == event.NOTE_OFF)
         {                                               // guard against devices with out-of-order events
           const auto last_frame = estream.last_frame();
           frames = std::max (frames, last_frame);
         }
-      int16_t frame_delay = CLAMP (frames, -2048, 0);   // ignore future scheduling, only account for delays
-      must_sort |= estream.append_unsorted (frame_delay, event);
+      const int16_t frame = CLAMP (frames, 0, max_frame); // events older than one block start the block
+      must_sort |= estream.append_unsorted (frame, event);
     };
     int r;
     while (r = snd_seq_event_input (seq_, &ev), r >= 0)
@@ -1243,6 +1373,379 @@ static const String alsa_seqmidi_driverid = MidiDriver::register_driver ("alsa",
                                                                          AlsaSeqMidiDriver::create,
                                                                          AlsaSeqMidiDriver::list_drivers);
 
+// == RawMidiParser ==
+/// Parser for the MIDI wire protocol, keeps running status across calls.
+struct RawMidiParser {
+  uint8 status_ = 0, data_[2] = {}, n_data_ = 0;
+  void
+  reset ()
+  {
+    status_ = 0;
+    n_data_ = 0;
+  }
+  /// Parse one byte of the MIDI wire protocol, returns true if `event` has been completed.
+  bool
+  parse_byte (uint8 byte, MidiEvent &event)
+  {
+    if (byte >= 0xf8)                   // realtime messages may interleave any message
+      return false;                     // clock, start, stop, active sensing are ignored
+    if (byte >= 0xf0)                   // system common messages cancel running status
+      {
+        status_ = 0;                    // sysex data bytes are skipped
+        n_data_ = 0;
+        return false;
+      }
+    if (byte & 0x80)
+      {
+        status_ = byte;
+        n_data_ = 0;
+        return false;
+      }
+    if (!status_)
+      return false;
+    data_[n_data_++] = byte;
+    const uint cmd = status_ & 0xf0, channel = status_ & 0x0f;
+    if (n_data_ < (cmd == 0xc0 || cmd == 0xd0 ? 1 : 2))
+      return false;
+    n_data_ = 0;                        // keep status_ for running status
+    const auto mkid = [] (uint note, uint channel) {
+      return (channel + 1) * 128 + note;
+    };
+    switch (cmd)
+      {
+      case 0x80:
+        event = make_note_off (channel, data_[0], data_[1] * (1.0 / 127.0), 0, mkid (data_[0], channel));
+        return true;
+      case 0x90:
+        if (data_[1] == 0)
+          event = make_note_off (channel, data_[0], 0, 0, mkid (data_[0], channel));
+        else
+          event = make_note_on (channel, data_[0], data_[1] * (1.0 / 127.0), 0, mkid (data_[0], channel));
+        return true;
+      case 0xa0:
+        event = make_aftertouch (channel, data_[0], data_[1] * (1.0 / 127.0), 0, mkid (data_[0], channel));
+        return true;
+      case 0xb0:
+        event = make_control8 (channel, data_[0], data_[1]);
+        return true;
+      case 0xc0:
+        event = make_program (channel, data_[0]);
+        return true;
+      case 0xd0:
+        event = make_pressure (channel, data_[0] * (1.0 / 127.0));
+        return true;
+      case 0xe0:
+        {
+          const int value = (data_[0] | data_[1] << 7) - 8192;
+          event = make_pitch_bend (channel, value * (value < 0 ? 1.0 / 8192.0 : 1.0 / 8191.0));
+          return true;
+        }
+      }
+    return false;
+  }
+};
+
+// == AlsaRawMidiDriver ==
+/// MIDI input from ALSA rawmidi devices, bypasses the sequencer to minimize latency and jitter.
+/// If the device fails, the driver stays opened but is not readable() until the reader thread reopens it.
+class AlsaRawMidiDriver : public MidiDriver {
+  struct Stamped {
+    int64     nsecs = 0;        // CLOCK_MONOTONIC time of reception
+    MidiEvent event;
+  };
+  static constexpr uint QUEUE_SIZE = 1024;
+  snd_rawmidi_t        *rawmidi_ = nullptr;
+  std::thread          *reader_ = nullptr;
+  EventFd               wakeup_;
+  std::atomic<bool>     reader_quit_ = false;
+  SpscRing<Stamped>     queue_ { QUEUE_SIZE };  // single producer (reader), single consumer (engine)
+  std::atomic<uint>     queue_dropped_ = 0;
+  RawMidiParser         parser_;                // reader thread state
+  bool                  mdebug_ = false;
+  static int64
+  monotonic_nsecs ()
+  {
+    struct timespec ts = {};
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * int64 (1000000000) + ts.tv_nsec;
+  }
+public:
+  static MidiDriverP
+  create (const String &devid)
+  {
+    auto mdriverp = std::make_shared<AlsaRawMidiDriver> (kvpair_key (devid), kvpair_value (devid));
+    return mdriverp;
+  }
+  explicit
+  AlsaRawMidiDriver (const String &driver, const String &devid) :
+    MidiDriver (driver, devid)
+  {}
+  ~AlsaRawMidiDriver()
+  {
+    cleanup();
+  }
+  static void
+  list_drivers (Driver::EntryVec &entries)
+  {
+    init_lib_alsa();
+    snd_ctl_card_info_t *cinfo = alsa_alloca0 (snd_ctl_card_info);
+    snd_rawmidi_info_t *rinfo = alsa_alloca0 (snd_rawmidi_info);
+    int cindex = -1;
+    while (snd_card_next (&cindex) == 0 && cindex >= 0)
+      {
+        snd_ctl_card_info_clear (cinfo);
+        snd_ctl_t *chandle = nullptr;
+        const String card_hw = string_format ("hw:CARD=%u", cindex);
+        if (snd_ctl_open (&chandle, card_hw.c_str(), SND_CTL_NONBLOCK) < 0 || !chandle)
+          continue;
+        if (snd_ctl_card_info (chandle, cinfo) < 0)
+          {
+            snd_ctl_close (chandle);
+            continue;
+          }
+        const String card_id = chars2string (snd_ctl_card_info_get_id (cinfo));
+        const String card_name = chars2string (snd_ctl_card_info_get_name (cinfo));
+        const String card_longname = chars2string (snd_ctl_card_info_get_longname (cinfo));
+        const bool is_usb = card_longname.find (" at usb-") != std::string::npos;
+        int dindex = -1;
+        while (snd_ctl_rawmidi_next_device (chandle, &dindex) == 0 && dindex >= 0)
+          {
+            snd_rawmidi_info_set_device (rinfo, dindex);
+            snd_rawmidi_info_set_subdevice (rinfo, 0);
+            snd_rawmidi_info_set_stream (rinfo, SND_RAWMIDI_STREAM_INPUT);
+            if (snd_ctl_rawmidi_info (chandle, rinfo) < 0)
+              continue; // output only device
+            const uint n_subdevices = snd_rawmidi_info_get_subdevices_count (rinfo);
+            for (uint sindex = 0; sindex < n_subdevices; sindex++)
+              {
+                snd_rawmidi_info_set_subdevice (rinfo, sindex);
+                if (snd_ctl_rawmidi_info (chandle, rinfo) < 0)
+                  continue;
+                Driver::Entry entry;
+                entry.devid = string_format ("hw:CARD=%s,DEV=%u,SUBDEV=%u", card_id, dindex, sindex);
+                entry.device_name = chars2string (snd_rawmidi_info_get_subdevice_name (rinfo));
+                if (entry.device_name.empty())
+                  entry.device_name = chars2string (snd_rawmidi_info_get_name (rinfo));
+                entry.device_name += " - " + card_name;
+                entry.capabilities = "Raw MIDI Input";
+                if (!string_startswith (card_longname, card_name + " at "))
+                  entry.device_info = card_longname;
+                entry.readonly = true;
+                entry.priority = is_usb ? Driver::ALSA_USB : Driver::ALSA_KERN;
+                entry.priority += Driver::WCARD * cindex;
+                entry.priority += Driver::WDEV * dindex;
+                entry.priority += Driver::WSUB * sindex;
+                entries.push_back (entry);
+                MDEBUG ("DISCOVER: %s - %s", entry.devid, entry.device_name);
+              }
+          }
+        snd_ctl_close (chandle);
+      }
+  }
+  virtual Error
+  open (IODir iodir) override
+  {
+    assert_return (!rawmidi_, Error::INTERNAL);
+    if (iodir != READONLY)
+      return Error::DEVICE_NOT_AVAILABLE;       // MIDI output is left to the sequencer driver
+    int aerror = wakeup_.opened() ? 0 : wakeup_.open();
+    if (!aerror)
+      aerror = snd_rawmidi_open (&rawmidi_, nullptr, devid_.c_str(), SND_RAWMIDI_NONBLOCK);
+    if (!aerror)
+      {
+        for (Stamped stamped; queue_.pop (stamped);) // discard events of a previous open()
+          ;
+        queue_dropped_ = 0;
+        parser_.reset();
+        snd_rawmidi_drop (rawmidi_);    // discard bytes received before opening
+        reader_quit_ = false;
+        reader_ = new std::thread (&AlsaRawMidiDriver::reader_thread, this);
+        flags_ |= Flags::OPENED | Flags::READABLE;
+      }
+    const Error error = !aerror ? Error::NONE : ase_error_from_errno (-aerror, Error::FILE_OPEN_FAILED);
+    MDEBUG ("RawMidi: %s: opening readable=%d: %s", devid_, readable(), ase_error_blurb (error));
+    if (error != Error::NONE)
+      cleanup();
+    else
+      mdebug_ = debug_key_enabled ("midievent");
+    return error;
+  }
+  void
+  cleanup()
+  {
+    if (reader_)
+      {
+        reader_quit_ = true;
+        wakeup_.wakeup();
+        reader_->join();
+        delete reader_;
+        reader_ = nullptr;
+        wakeup_.flush();
+      }
+    if (rawmidi_)
+      {
+        snd_rawmidi_close (rawmidi_);
+        rawmidi_ = nullptr;
+      }
+  }
+  virtual void
+  close () override
+  {
+    assert_return (opened());
+    cleanup();
+    MDEBUG ("RawMidi: %s: CLOSE: r=%d dropped=%u", devid_, readable(), queue_dropped_.load());
+    flags_ &= ~size_t (Flags::OPENED | Flags::READABLE | Flags::WRITABLE);
+    mdebug_ = false;
+  }
+  /// Read and parse MIDI input until quit, reopens the device if it vanishes (e.g. USB unplug).
+  void
+  reader_thread ()
+  {
+    this_thread_set_name ("AseRawMidi"); // max 16 chars
+    sched_fast_priority (this_thread_gettid());
+    while (!reader_quit_)
+      {
+        const String error = read_events();
+        if (reader_quit_)
+          break;
+        // device failed, stop reporting READABLE and retry once per second until it reappears
+        flags_ &= ~size_t (Flags::READABLE);
+        printerr ("ALSA: %s: MIDI input lost: %s\n", devid_, error);
+        snd_rawmidi_close (rawmidi_);
+        rawmidi_ = nullptr;
+        struct pollfd pfd = { wakeup_.inputfd(), POLLIN, 0 };
+        while (!reader_quit_ && !rawmidi_)
+          if (poll (&pfd, 1, 1000) == 0 && snd_rawmidi_open (&rawmidi_, nullptr, devid_.c_str(), SND_RAWMIDI_NONBLOCK) < 0)
+            rawmidi_ = nullptr;
+        if (!rawmidi_)
+          break;
+        parser_.reset();
+        flags_ |= Flags::READABLE;
+        printerr ("ALSA: %s: MIDI input reconnected\n", devid_);
+      }
+  }
+  /// Poll rawmidi_ and queue parsed events until quit or an error occurs, returns the error.
+  String
+  read_events ()
+  {
+    const int n_pfds = snd_rawmidi_poll_descriptors_count (rawmidi_);
+    std::vector<struct pollfd> pfds (std::max (0, n_pfds) + 1);
+    const int n_rfds = std::max (0, snd_rawmidi_poll_descriptors (rawmidi_, pfds.data(), n_pfds));
+    pfds[n_rfds] = { wakeup_.inputfd(), POLLIN, 0 };
+    uint8 buffer[256];
+    while (!reader_quit_)
+      {
+        if (poll (pfds.data(), n_rfds + 1, -1) < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            return string_format ("poll: %s", strerror (errno));
+          }
+        unsigned short revents = 0;
+        const int rerror = snd_rawmidi_poll_descriptors_revents (rawmidi_, pfds.data(), n_rfds, &revents);
+        if (rerror < 0)
+          return snd_strerror (rerror);
+        if (revents & (POLLERR | POLLHUP))
+          return "device disconnected";
+        if (!(revents & POLLIN))
+          continue;
+        const int64 nsecs = monotonic_nsecs();
+        ssize_t l;
+        while (l = snd_rawmidi_read (rawmidi_, buffer, sizeof (buffer)), l > 0)
+          for (ssize_t i = 0; i < l; i++)
+            {
+              MidiEvent event;
+              if (parser_.parse_byte (buffer[i], event))
+                push (nsecs, event);
+            }
+        if (l < 0 && l != -EAGAIN)
+          return string_format ("snd_rawmidi_read: %s", snd_strerror (l));
+      }
+    return "";
+  }
+  void
+  push (int64 nsecs, const MidiEvent &event)
+  {
+    if (!queue_.push ({ nsecs, event }))
+      queue_dropped_++;                 // engine is not draining, e.g. while stalled
+  }
+  bool
+  has_events () override
+  {
+    assert_return (opened(), false);
+    return !queue_.empty();
+  }
+  uint
+  fetch_events (MidiEventOutput &estream, double samplerate, uint n_frames) override
+  {
+    assert_return (opened(), 0);
+    const size_t old_size = estream.size();
+    const int64 now = monotonic_nsecs();
+    // like the sequencer driver, apply a fixed latency of one block for sample accurate positions
+    const int64_t max_frame = std::max (1u, n_frames) - 1;
+    bool must_sort = false;
+    for (Stamped stamped; queue_.pop (stamped);)
+      {
+        const double diff = 1e-9 * (stamped.nsecs - now); // <= 0 for received events
+        int64_t frames = n_frames + int64_t (diff * samplerate);
+        if (stamped.event.type == MidiEvent::NOTE_OFF)
+          frames = std::max (frames, estream.last_frame());
+        const int16_t frame = CLAMP (frames, 0, max_frame);
+        must_sort |= estream.append_unsorted (frame, stamped.event);
+      }
+    if (ASE_UNLIKELY (mdebug_))
+      for (size_t i = old_size; i < estream.size(); i++)
+        MDEBUG ("%s", (estream.begin() + i)->to_string());
+    if (must_sort)
+      estream.ensure_order();
+    return estream.size() - old_size;
+  }
+};
+
+static const String alsa_rawmidi_driverid = MidiDriver::register_driver ("rawmidi",
+                                                                         AlsaRawMidiDriver::create,
+                                                                         AlsaRawMidiDriver::list_drivers);
+
+TEST_INTEGRITY (alsa_rawmidi_parser_test);
+static void
+alsa_rawmidi_parser_test()
+{
+  RawMidiParser parser;
+  std::vector<MidiEvent> events;
+  auto parse = [&] (const std::vector<uint8> &bytes) {
+    events.clear();
+    for (uint8 byte : bytes)
+      {
+        MidiEvent event;
+        if (parser.parse_byte (byte, event))
+          events.push_back (event);
+      }
+  };
+  // running status, with realtime clock bytes interleaved into a message
+  parse ({ 0x91, 60, 0xf8, 100, 62, 0xfe, 50 });
+  TASSERT (events.size() == 2);
+  TASSERT (events[0].type == MidiEvent::NOTE_ON && events[0].channel == 1 && events[0].key == 60);
+  TASSERT (std::abs (events[0].velocity - 100 / 127.0) < 1e-6);
+  TASSERT (events[1].type == MidiEvent::NOTE_ON && events[1].key == 62);
+  // note-on with velocity 0 is a note-off
+  parse ({ 60, 0 });
+  TASSERT (events.size() == 1 && events[0].type == MidiEvent::NOTE_OFF && events[0].key == 60);
+  // sysex data is skipped and cancels running status
+  parse ({ 0xf0, 0x7e, 0x01, 0x02, 0xf7, 64, 100 });
+  TASSERT (events.size() == 0);
+  parse ({ 0x90, 64, 100 });
+  TASSERT (events.size() == 1 && events[0].type == MidiEvent::NOTE_ON && events[0].channel == 0 && events[0].key == 64);
+  // pitch bend, 14 bit value centered at 0x2000
+  parse ({ 0xe3, 0x00, 0x40, 0x00, 0x00, 0x7f, 0x7f });
+  TASSERT (events.size() == 3);
+  TASSERT (events[0].type == MidiEvent::PITCH_BEND && events[0].channel == 3 && events[0].value == 0);
+  TASSERT (events[1].value == -1);
+  TASSERT (events[2].value == 1);
+  // single data byte messages
+  parse ({ 0xc2, 5, 7 });
+  TASSERT (events.size() == 2 && events[0].type == MidiEvent::PROGRAM_CHANGE && events[1].param == 7);
+}
+
 static std::string
 hex_str (uint len, const uint8 *d)
 {
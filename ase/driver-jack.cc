@@ -69,6 +69,11 @@ This avoids latency and buffering. However this may pose stricter RT
 requirements onto ANKLANG. So whether it runs as dropout-free as the current
 version would remain to be seen. A not so realtime version would buffer
 M complete blocks of N samples, still avoiding partially filled buffers.
+
+Callback mode (PcmDriverConfig::callback_mode) goes one step further and
+skips the thread handoff: the engine registers as PcmRenderer and runs its
+render cycle directly inside the JACK process callback, using the JACK period
+as engine block size. The ring buffers are not used in this mode.
 ------------------------------------------------------------------------*/
 
 /**
@@ -440,6 +445,9 @@ class JackPcmDriver : public PcmDriver {
   uint                          buffer_frames_ = 0;        /* input/output ringbuffer size in frames */
   uint                          block_length_ = 0;
 
+  bool                          callback_mode_ = false;    /* render from process_callback, no ring buffers */
+  std::atomic<PcmRenderer*>     renderer_ = nullptr;
+
   std::atomic<int>              atomic_active_ {0};
   std::atomic<int>              atomic_xruns_ {0};
   int                           printed_xruns_ = 0;
@@ -466,7 +474,16 @@ class JackPcmDriver : public PcmDriver {
         out_values[ch] = (float *) jack_port_get_buffer (output_ports_[ch], n_frames);
       }
 
-    if (!atomic_active_)
+    if (callback_mode_)
+      {
+        /* render directly into the port buffers, avoids ring buffer latency and thread handoff */
+        if (PcmRenderer *renderer = renderer_.load (std::memory_order_acquire))
+          renderer->pcm_render (n_frames, n_channels_, in_values, out_values);
+        else
+          for (auto values : out_values)
+            floatfill (values, 0.0, n_frames);
+      }
+    else if (!atomic_active_)
       {
         for (auto values : out_values)
           floatfill (values, 0.0, n_frames);
@@ -573,6 +590,14 @@ public:
   {
     return block_length_;
   }
+  bool
+  pcm_set_renderer (PcmRenderer *renderer) override
+  {
+    if (!callback_mode_)
+      return false;
+    renderer_.store (renderer, std::memory_order_release);
+    return true;
+  }
   virtual void
   close () override
   {
@@ -600,6 +625,9 @@ public:
 
     mix_freq_ = jack_get_sample_rate (jack_client_);
     block_length_ = config.block_length;
+    callback_mode_ = config.callback_mode;
+    if (callback_mode_) // the engine follows the JACK period in callback mode
+      block_length_ = std::min (jack_get_buffer_size (jack_client_), config.block_length);
 
     for (uint i = 0; i < n_channels_; i++)
       {
@@ -623,7 +651,7 @@ public:
       }
 
     /* initialize ring buffers */
-    if (error == 0)
+    if (error == 0 && !callback_mode_)
       {
         // keep at least two jack callback sizes for dropout free audio
         uint min_buffer_frames = jack_get_buffer_size (jack_client_) * 2;
@@ -730,7 +758,7 @@ public:
         disconnect_jack (jack_client_);
         jack_client_ = nullptr;
       }
-    JDEBUG ("%s: opening PCM: readable=%d writable=%d mix=%.1fHz block=%d: %s", devid_, readable(), writable(), mix_freq_, block_length_, ase_error_blurb (error));
+    JDEBUG ("%s: opening PCM: readable=%d writable=%d mix=%.1fHz block=%d callback=%d: %s", devid_, readable(), writable(), mix_freq_, block_length_, callback_mode_, ase_error_blurb (error));
     return error;
   }
   virtual bool
@@ -762,6 +790,13 @@ public:
     /* enable processing in callback (if not already active) */
     atomic_active_ = 1;
 
+    /* in callback mode, the engine renders from process_callback */
+    if (callback_mode_)
+      {
+        *timeoutp = 1000;
+        return false;
+      }
+
     /* report jack driver xruns */
     if (atomic_xruns_ != printed_xruns_)
       {
@@ -832,6 +867,11 @@ public:
   {
     assert_return (jack_client_ != nullptr, 0);
     assert_return (n == block_length_ * n_channels_, 0);
+    if (callback_mode_)
+      {
+        floatfill (values, 0.0, n);
+        return n;
+      }
 
     device_read_counter_++;  // read must always gets called before write (see jack_device_write)
 
@@ -863,6 +903,7 @@ public:
   {
     assert_return (jack_client_ != nullptr);
     assert_return (n == block_length_ * n_channels_);
+    return_unless (!callback_mode_);
 
     /* our buffer management is based on the assumption that jack_device_read()
      * will always be performed before jack_device_write() - ANKLANG doesn't
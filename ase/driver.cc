@@ -412,7 +412,7 @@ public:
     return false;
   }
   uint
-  fetch_events (MidiEventOutput&, double) override
+  fetch_events (MidiEventOutput&, double, uint) override
   {
     return 0;
   }
@@ -30,7 +30,7 @@ class Driver : public std::enable_shared_from_this<Driver> {
 protected:
   struct Flags { enum { OPENED = 1, READABLE = 2, WRITABLE = 4, }; };
   const String       driver_, devid_;
-  size_t             flags_ = 0;
+  std::atomic<size_t> flags_ = 0;
   explicit           Driver     (const String &driver, const String &devid);
   virtual           ~Driver     ();
   template<class Derived> std::shared_ptr<Derived>
@@ -79,7 +79,7 @@ public:
   typedef std::shared_ptr<MidiDriver> MidiDriverP;
   static MidiDriverP open            (const String &devid, IODir iodir, Ase::Error *ep);
   virtual bool       has_events      () = 0;
-  virtual uint       fetch_events    (MidiEventOutput &estream, double samplerate) = 0;
+  virtual uint       fetch_events    (MidiEventOutput &estream, double samplerate, uint n_frames) = 0;
   static EntryVec    list_drivers    ();
   static String      register_driver (const String &driverid,
                                       const std::function<MidiDriverP (const String&)> &create,
@@ -93,6 +93,14 @@ struct PcmDriverConfig {
   uint mix_freq = 0;
   uint block_length = 0;
   uint latency_ms = 0;
+  bool callback_mode = false;   ///< Render from the driver's process callback if supported, see PcmRenderer.
+};
+
+/// Interface for render cycles that run inside a PCM driver's process callback.
+class PcmRenderer {
+public:
+  /// Render `n_frames` from non-interleaved `ichannels` into `ochannels`, called from the driver thread.
+  virtual void pcm_render (uint n_frames, uint n_channels, const float *const *ichannels, float *const *ochannels) = 0;
 };
 
 /// Base class for a PCM devices.
@@ -110,6 +118,7 @@ public:
   virtual bool       pcm_check_io     (int64 *timeoutp) = 0;
   virtual size_t     pcm_read         (size_t n, float *values) = 0;
   virtual void       pcm_write        (size_t n, const float *values) = 0;
+  virtual bool       pcm_set_renderer (PcmRenderer *renderer) { return false; }
   static EntryVec    list_drivers     ();
   static String      register_driver  (const String &driverid,
                                        const std::function<PcmDriverP (const String&)> &create,
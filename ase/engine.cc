@@ -9,24 +9,38 @@
 #include "atomics.hh"
 #include "project.hh"
 #include "wave.hh"
+#include "clapplugin.hh"
 #include "main.hh"      // main_loop_autostop_mt
 #include "memory.hh"
 #include "internal.hh"
+#include "testing.hh"
 
 #define EDEBUG(...)             Ase::debug ("engine", __VA_ARGS__)
 
 namespace Ase {
 
-constexpr const uint FIXED_N_CHANNELS = 2;
-constexpr const uint FIXED_SAMPLE_RATE = 48000;
 constexpr const uint FIXED_N_MIDI_DRIVERS = 4;
 
 // == decls ==
 using VoidFunc = std::function<void()>;
 using StartQueue = AsyncBlockingQueue<char>;
 ASE_CLASS_DECLS (EngineMidiInput);
+ASE_CLASS_DECLS (EngineAudioInput);
 static void apply_driver_preferences ();
 
+/// Hint the CPU that the current thread is busy-waiting.
+static inline void
+cpu_relax ()
+{
+#if defined __x86_64__ || defined __i386__
+  __builtin_ia32_pause();
+#elif defined __aarch64__ || defined __arm__
+  __asm__ __volatile__ ("yield" ::: "memory");
+#else
+  ASE_CFENCE;
+#endif
+}
+
 // == EngineJobImpl ==
 struct EngineJobImpl {
   VoidFunc func;
@@ -39,7 +53,130 @@ atomic_next_ptrref (EngineJobImpl *j)
   return j->next;
 }
 
+// == RenderDag ==
+/// Dependency counted execution of nodes by several threads, a node becomes runnable once all its producers are done.
+class RenderDag {
+  static constexpr uint64 CLOSED = 0xffffffff;
+  struct Node {
+    uint n_deps = 0;                    // number of producers
+    uint succ_start = 0, succ_end = 0;  // consumers in succs_
+  };
+  std::vector<Node>              nodes_;
+  std::vector<uint>              succs_;        // consumer indices
+  std::vector<uint>              roots_;        // nodes without producers
+  std::vector<std::atomic<uint>> pending_;      // producers left to run per node
+  std::vector<std::atomic<uint>> ready_;        // queue of runnable node indices + 1
+  std::atomic<uint64>            head_ alignas (64) = CLOSED; // generation << 32 | next ready slot
+  std::atomic<uint>              tail_ alignas (64) = 0;
+  std::atomic<uint>              done_ alignas (64) = 0;
+  std::atomic<uint>              count_ = 0;
+  uint64                         gen_ = 0;
+public:
+  void assign (uint n_nodes, std::vector<std::pair<uint,uint>> edges);
+  void clear  ()        { count_ = 0; }
+  uint size   () const  { return count_; }
+  /// Check if all nodes of the current run are done.
+  bool done   () const  { return done_.load (std::memory_order_acquire) >= count_.load (std::memory_order_relaxed); }
+  void open   ();
+  /// Stop threads from entering the current run.
+  void close  ()        { head_ = gen_ << 32 | CLOSED; }
+  template<class F, class W>
+  void run    (const F &func, const W &wait);
+};
+
+/// Setup `n_nodes` connected by (producer, consumer) `edges`, duplicates and self edges are ignored.
+void
+RenderDag::assign (uint n_nodes, std::vector<std::pair<uint,uint>> edges)
+{
+  std::sort (edges.begin(), edges.end());
+  edges.erase (std::unique (edges.begin(), edges.end()), edges.end());
+  nodes_.assign (n_nodes, Node{});
+  succs_.clear();
+  roots_.clear();
+  size_t e = 0;
+  for (uint i = 0; i < n_nodes; i++)
+    {
+      nodes_[i].succ_start = succs_.size();
+      for (; e < edges.size() && edges[e].first == i; e++)
+        if (edges[e].second != i && edges[e].second < n_nodes)
+          {
+            succs_.push_back (edges[e].second);
+            nodes_[edges[e].second].n_deps++;
+          }
+      nodes_[i].succ_end = succs_.size();
+    }
+  for (uint i = 0; i < n_nodes; i++)
+    if (nodes_[i].n_deps == 0)
+      roots_.push_back (i);
+  pending_ = std::vector<std::atomic<uint>> (n_nodes);
+  ready_ = std::vector<std::atomic<uint>> (n_nodes);
+  count_ = n_nodes;
+}
+
+/// Start a new run, where only nodes without producers are runnable.
+void
+RenderDag::open ()
+{
+  const uint n_nodes = count_;
+  for (size_t i = 0; i < n_nodes; i++)
+    {
+      pending_[i].store (nodes_[i].n_deps, std::memory_order_relaxed);
+      ready_[i].store (0, std::memory_order_relaxed);
+    }
+  for (size_t i = 0; i < roots_.size(); i++)
+    ready_[i].store (1 + roots_[i], std::memory_order_relaxed);
+  tail_ = roots_.size();
+  done_ = 0;
+  head_ = ++gen_ << 32;
+}
+
+/// Claim runnable nodes and call `func (index)` until all are claimed, `wait()` is called while producers are busy.
+template<class F, class W> void
+RenderDag::run (const F &func, const W &wait)
+{
+  uint64 head = head_.load();
+  const uint64 gen = head >> 32;
+  while (head >> 32 == gen && (head & 0xffffffff) < count_)
+    {
+      const uint slot = head & 0xffffffff;
+      if (slot >= tail_.load (std::memory_order_acquire))
+        {
+          wait();                       // wait for producers
+          cpu_relax();
+          head = head_.load();
+          continue;
+        }
+      if (!head_.compare_exchange_weak (head, head + 1))
+        continue;                       // head was reloaded
+      uint index;
+      while (!(index = ready_[slot].load (std::memory_order_acquire)))
+        cpu_relax();                    // wait until slot is written
+      func (index - 1);
+      const Node &node = nodes_[index - 1];
+      for (size_t i = node.succ_start; i < node.succ_end; i++)
+        {
+          const uint succ = succs_[i];
+          if (pending_[succ].fetch_sub (1, std::memory_order_acq_rel) == 1)
+            ready_[tail_.fetch_add (1)].store (1 + succ, std::memory_order_release);
+        }
+      done_.fetch_add (1, std::memory_order_release);
+      head = head_.load();
+    }
+}
+
+/// Render deadline statistics, located in telemetry memory.
+struct DeadlineStats {
+  int32 n_misses = 0;           // blocks rendered slower than realtime
+  int32 n_near_misses = 0;      // blocks that used up most of the budget
+  float load = 0;               // last render duration / block budget
+  float max_load = 0;
+};
+
 struct DriverSet {
+  uint        mix_freq = 0;
+  uint        n_channels = 0;
+  bool        pcm_input = false;
+  bool        callback_mode = false;
   PcmDriverP  null_pcm_driver;
   String      pcm_name;
   PcmDriverP  pcm_driver;
@@ -48,16 +185,42 @@ struct DriverSet {
 };
 
 // == AudioEngineThread ==
-class AudioEngineThread : public AudioEngine {
+class AudioEngineThread : public AudioEngine, public PcmRenderer {
 public:
-  static constexpr uint        fixed_n_channels = 2;
+  static constexpr uint        MAX_CHANNELS = 2;
+  uint                         n_channels_ = 2;
   PcmDriverP                   null_pcm_driver_, pcm_driver_;
   constexpr static size_t      MAX_BUFFER_SIZE = AUDIO_BLOCK_MAX_RENDER_SIZE;
   std::atomic<uint64_t>        buffer_size_ = MAX_BUFFER_SIZE; // mono buffer size
-  float                        chbuffer_data_[MAX_BUFFER_SIZE * fixed_n_channels] = { 0, };
+  enum class BlockPolicy { PERIOD, EVENTS, FIXED };
+  static constexpr uint        SUB_BLOCK_SIZE = 64;     // frames per sub-block for BlockPolicy::FIXED
+  static constexpr uint        SUB_BLOCK_MIN = 32;      // shorter sub-blocks are merged with their neighbours
+  std::atomic<BlockPolicy>     block_policy_ = BlockPolicy::PERIOD;
+  bool                         period_split_ = false;   // period is rendered as sub-blocks
+  uint                         block_offset_ = 0;       // sub-block position within the current period
+  MidiEventOutput              period_events_;          // MIDI input events of a split period
+  static constexpr size_t      MIDI_ARENA_SIZE = 16384; // events shared by all MidiEventOutput streams per block
+  MidiEventArena               midi_arena_ { MIDI_ARENA_SIZE };
+  std::atomic<uint64>          midi_dropped_ = 0;       // MIDI events lost by MidiEventOutput overflows
+  uint64                       midi_dropped_noted_ = 0; // accessed by main_loop thread
+  float                        chbuffer_data_[MAX_BUFFER_SIZE * MAX_CHANNELS] = { 0, };
+  float                        ibuffer_data_[MAX_BUFFER_SIZE * MAX_CHANNELS] = { 0, };
+  // callback mode renders multiples of AUDIO_BLOCK_MIN_RENDER_SIZE, unaligned frames are carried to the next callback
+  static constexpr uint        CARRY_SIZE = AUDIO_BLOCK_MIN_RENDER_SIZE;
+  float                        icarry_data_[CARRY_SIZE * MAX_CHANNELS] = { 0, }; // input frames not yet rendered
+  float                        ocarry_data_[CARRY_SIZE * MAX_CHANNELS] = { 0, }; // rendered frames not yet delivered
+  uint                         icarry_ = 0, ocarry_ = 0;
+  uint                         n_ichannels_ = 0;        // 0 for output only PCM drivers
+  std::atomic<uint>            roundtrip_latency_ = 0;  // PCM input to output latency in frames
+  uint                         latency_countdown_ = 0;
+  static constexpr uint64      CALLBACK_STALL_USECS = 50 * 1000;
+  std::atomic<bool>            callback_mode_ = false;  // PCM driver runs render cycles from its process callback
+  std::atomic<uint64>          callback_usecs_ = 0;     // time of the last process callback
+  std::atomic_flag             cycle_lock_ = ATOMIC_FLAG_INIT; // held while running jobs and render cycles
   uint64                       write_stamp_ = 0;
   std::vector<AudioProcessor*> schedule_;
   EngineMidiInputP             midi_proc_;
+  EngineAudioInputP            input_proc_;
   bool                         schedule_invalid_ = true;
   bool                         output_needsrunning_ = false;
   AtomicIntrusiveStack<EngineJobImpl> async_jobs_, const_jobs_, trash_jobs_;
@@ -66,31 +229,122 @@ public:
   MainLoopP                    event_loop_ = MainLoop::create();
   AudioProcessorS              oprocs_;
   ProjectImplP                 project_;
-  WaveWriterP                  wwriter_;
+  AsyncWaveWriterP             wwriter_;
+  struct StemCapture {
+    AudioProcessorP  proc;
+    AsyncWaveWriterP writer;
+  };
+  std::vector<StemCapture>     stems_;
+  float                        stembuffer_data_[MAX_BUFFER_SIZE * MAX_CHANNELS] = { 0, };
+  // plugin delay compensation
+  static constexpr uint        MAX_COMPENSATION = 65536; // frames
+  struct OutputDelay {
+    AudioProcessor    *proc = nullptr;
+    uint               delay = 0;
+    uint               pos = 0;         // write index into each circular line
+    std::vector<float> lines;           // MAX_CHANNELS * (delay + MAX_BUFFER_SIZE)
+  };
+  std::vector<OutputDelay>     output_delays_;          // indices match oprocs_ after schedule_update()
+  std::atomic<bool>            output_delays_pending_ = false; // update_output_delays_ml() is queued
+  float                        delaybuffer_data_[MAX_BUFFER_SIZE * MAX_CHANNELS] = { 0, };
+  bool                         capture_overflow_ = false;
+  std::atomic<uint64>          capture_dropped_ = 0;    // frames lost by capture ring overflows
+  std::atomic<uint>            capture_overflows_ = 0;
+  uint                         capture_overflows_noted_ = 0; // accessed by main_loop thread
   FastMemory::Block            transport_block_;
   DriverSet                    driver_set_ml; // accessed by main_loop thread
   std::atomic<uint64>          autostop_ = U64MAX;
+  std::atomic<bool>            offline_ = false;        // render faster than realtime during playback
+  bool                         offline_active_ = false; // bypassing PCM output
+  std::atomic<uint>            realtime_holds_ = 0;     // processors that require PCM paced rendering
+  std::atomic<uint64>          offline_frames_ = 0;
   struct UserNoteJob {
     std::atomic<UserNoteJob*> next = nullptr;
     UserNote note;
   };
   AtomicIntrusiveStack<UserNoteJob> user_notes_;
+  // render workers
+  struct RenderItem {
+    AudioProcessor *proc = nullptr;
+    uint            level = 0;
+  };
+  static constexpr uint64      RENDER_CLOSED = 0xffffffff;
+  std::vector<std::pair<AudioProcessor*,AudioProcessor*>> schedule_deps_; // consumer, producer
+  std::vector<RenderItem>      render_items_;   // topologically sorted processors
+  RenderDag                    render_dag_;     // dependencies between render_items_
+  std::atomic<uint64>          render_target_ = 0;
+  std::atomic<uint>            render_workers_active_ = 0;
+  std::atomic<bool>            render_workers_quit_ = false;
+  std::vector<std::thread*>    render_workers_; // accessed by main_loop thread
+  ScopedSemaphore              render_sem_;
+  // parallel processor tasks, see AudioEngine::parallel_exec()
+  std::atomic<uint64>          task_head_ alignas (64) = RENDER_CLOSED; // generation << 32 | next task index
+  std::atomic<uint>            task_done_ alignas (64) = 0;
+  std::atomic<uint>            task_count_ = 0;
+  std::atomic<bool>            task_busy_ = false;
+  AudioEngine::ParallelTask    task_func_ = nullptr;
+  void                        *task_data_ = nullptr;
+  uint64                       task_gen_ = 0;
+  // deadline monitor
+  struct DeadlineIncident {
+    uint64  frame = 0;                  // render_stamp_ of the late block
+    uint64  usecs = 0;                  // wall clock time
+    float   load = 0;                   // render duration / block budget
+    uint    level = 0;                  // schedule level of the slowest processor
+    float   proc_usecs = 0;             // render duration of the slowest processor
+    CString proc_aseid;
+  };
+  static constexpr uint        DEADLINE_NEAR_MISS = 80; // percent of budget
+  static constexpr uint        DEADLINE_BURST = 3;      // misses per second that trigger a user note
+  std::array<DeadlineIncident,32> deadline_incidents_;
+  uint64                       deadline_n_incidents_ = 0;
+  uint64                       deadline_burst_frame_ = 0;
+  uint                         deadline_burst_misses_ = 0;
+  std::atomic<uint>            deadline_bursts_ = 0;
+  uint                         deadline_bursts_noted_ = 0; // accessed by main_loop thread
+  FastMemory::Block            deadline_block_;
+  DeadlineStats               *deadline_stats_ = nullptr;
 public:
   virtual        ~AudioEngineThread      ();
   explicit        AudioEngineThread      (const VoidF&, uint, SpeakerArrangement, const FastMemory::Block&);
   void            schedule_clear         ();
   void            schedule_add           (AudioProcessor &aproc, uint level);
+  void            schedule_depend        (AudioProcessor &consumer, AudioProcessor &producer);
   void            schedule_queue_update  ();
-  void            schedule_render        (uint64 frames);
+  void            schedule_flatten       ();
+  void            schedule_render        (uint64 frames, uint64 offset);
+  void            schedule_update        ();
+  void            update_output_delays   ();
+  void            update_output_delays_ml ();
+  uint            output_floats          (size_t i, uint n_frames, const float **srcs);
+  void            render_period          (uint64 frames);
+  void            render_ready_items     ();
+  void            render_worker          (uint nth);
+  void            parallel_exec          (uint n_tasks, AudioEngine::ParallelTask func, void *data);
+  void            parallel_help          ();
+  void            update_render_workers_ml (uint n_workers);
+  void            deadline_check         (uint64 render_nsecs);
   void            enable_output          (AudioProcessor &aproc, bool onoff);
   void            wakeup_thread_mt       ();
-  void            capture_start          (const String &filename, bool needsrunning);
+  void            capture_start          (AsyncWaveWriterP wwriter, bool needsrunning);
+  void            capture_write          (AsyncWaveWriter &writer, const float *frames, size_t n_frames);
   void            capture_stop           ();
+  void            capture_stems          (const std::vector<StemCapture> &stems, bool needsrunning);
+  void            stems_stop             ();
+  bool            capture_stalled        () const;
   bool            ipc_pending            ();
   void            ipc_dispatch           ();
   AudioProcessorP get_event_source       ();
+  AudioProcessorP get_audio_input        ();
   void            add_job_mt             (EngineJobImpl *aejob, const AudioEngine::JobQueue *jobqueue);
   bool            pcm_check_write        (bool write_buffer, int64 *timeout_usecs_p = nullptr);
+  void            pcm_input_read         ();
+  void            pcm_render             (uint n_frames, uint n_channels, const float *const *ichannels, float *const *ochannels) override;
+  void            render_cycle           (bool from_callback);
+  bool            offline_pending        () const;
+  bool            callback_stalled       () const;
+  void            output_write           ();
+  void            offline_update         ();
   bool            driver_dispatcher      (const LoopState &state);
   bool            process_jobs           (AtomicIntrusiveStack<EngineJobImpl> &joblist);
   void            run                    (StartQueue *sq);
@@ -98,6 +352,7 @@ public:
   void            set_project            (ProjectImplP project);
   ProjectImplP    get_project            ();
   void            update_driver_set      (DriverSet &dset);
+  void            reconfigure            (uint sample_rate, uint n_channels);
   void            start_threads_ml       ();
   void            stop_threads_ml        ();
   void            create_processors_ml   ();
@@ -106,6 +361,8 @@ public:
 
 static std::thread::id audio_engine_thread_id = {};
 const ThreadId &AudioEngine::thread_id = audio_engine_thread_id;
+static thread_local bool audio_render_worker = false;
+static thread_local bool audio_cycle_owner = false;     // thread holds cycle_lock_
 
 static inline std::atomic<AudioEngineThread::UserNoteJob*>&
 atomic_next_ptrref (AudioEngineThread::UserNoteJob *j)
@@ -114,45 +371,73 @@ atomic_next_ptrref (AudioEngineThread::UserNoteJob *j)
 }
 
 template<int ADDING> static void
-interleaved_stereo (const size_t n_frames, float *buffer, AudioProcessor &proc, OBusId obus)
+interleaved_stereo (const size_t n_frames, float *buffer, const float *const *srcs, uint n_srcs)
 {
-  if (proc.n_ochannels (obus) >= 2)
+  if (n_srcs >= 1)
     {
-      const float *src0 = proc.ofloats (obus, 0);
-      const float *src1 = proc.ofloats (obus, 1);
+      const float *src0 = srcs[0];
+      const float *src1 = n_srcs >= 2 ? srcs[1] : src0;
+      if_constexpr (ADDING == 0)
+        interleave2 (n_frames / 2, buffer, src0, src1);
+      else
+        interleave2_add (n_frames / 2, buffer, src0, src1);
+    }
+}
+
+template<int ADDING> static void
+mono_mixdown (const size_t n_frames, float *buffer, const float *const *srcs, uint n_srcs)
+{
+  if (n_srcs >= 2)
+    {
+      const float *src0 = srcs[0];
+      const float *src1 = srcs[1];
       float *d = buffer, *const b = d + n_frames;
       do {
         if_constexpr (ADDING == 0)
-          {
-            *d++ = *src0++;
-            *d++ = *src1++;
-          }
+          *d++ = 0.5 * (*src0++ + *src1++);
         else
-          {
-            *d++ += *src0++;
-            *d++ += *src1++;
-          }
+          *d++ += 0.5 * (*src0++ + *src1++);
       } while (d < b);
     }
-  else if (proc.n_ochannels (obus) >= 1)
+  else if (n_srcs >= 1)
     {
-      const float *src = proc.ofloats (obus, 0);
+      const float *src = srcs[0];
       float *d = buffer, *const b = d + n_frames;
       do {
         if_constexpr (ADDING == 0)
-          {
-            *d++ = *src;
-            *d++ = *src++;
-          }
+          *d++ = *src++;
         else
-          {
-            *d++ += *src;
-            *d++ += *src++;
-          }
+          *d++ += *src++;
       } while (d < b);
     }
 }
 
+/// Fetch up to 2 channels of output bus `obus` into `srcs`, returns the number of channels.
+static uint
+stereo_ofloats (AudioProcessor &proc, OBusId obus, const float **srcs)
+{
+  const uint n_srcs = std::min (proc.n_ochannels (obus), 2u);
+  for (uint c = 0; c < n_srcs; c++)
+    srcs[c] = proc.ofloats (obus, c);
+  return n_srcs;
+}
+
+template<int ADDING> static void
+interleaved_stereo (const size_t n_frames, float *buffer, AudioProcessor &proc, OBusId obus)
+{
+  const float *srcs[2] = {};
+  const uint n_srcs = stereo_ofloats (proc, obus, srcs);
+  interleaved_stereo<ADDING> (n_frames, buffer, srcs, n_srcs);
+}
+
+template<int ADDING> static void
+mono_mixdown (const size_t n_frames, float *buffer, AudioProcessor &proc, OBusId obus)
+{
+  const float *srcs[2] = {};
+  const uint n_srcs = stereo_ofloats (proc, obus, srcs);
+  mono_mixdown<ADDING> (n_frames, buffer, srcs, n_srcs);
+}
+
 void
 AudioEngineThread::schedule_queue_update()
 {
@@ -174,6 +459,9 @@ AudioEngineThread::schedule_clear()
           proc->sched_next_ = nullptr;
         }
     }
+  schedule_deps_.clear();
+  render_items_.clear();
+  render_dag_.clear();
   schedule_invalid_ = true;
 }
 
@@ -192,38 +480,296 @@ AudioEngineThread::schedule_add (AudioProcessor &aproc, uint level)
 }
 
 void
-AudioEngineThread::schedule_render (uint64 frames)
+AudioEngineThread::schedule_depend (AudioProcessor &consumer, AudioProcessor &producer)
+{
+  schedule_deps_.push_back ({ &consumer, &producer });
+}
+
+void
+AudioEngineThread::schedule_flatten ()
+{
+  // levels yield a topological order, so processors can be rendered sequentially
+  std::unordered_map<AudioProcessor*,uint> indices;
+  render_items_.clear();
+  for (size_t l = 0; l < schedule_.size(); l++)
+    for (AudioProcessor *proc = schedule_[l]; proc; proc = proc->sched_next_)
+      {
+        indices[proc] = render_items_.size();
+        render_items_.push_back ({ proc, uint (l) });
+      }
+  // producer -> consumer edges
+  std::vector<std::pair<uint,uint>> edges;
+  edges.reserve (schedule_deps_.size());
+  for (const auto &[consumer, producer] : schedule_deps_)
+    {
+      const auto c = indices.find (consumer), p = indices.find (producer);
+      if (c != indices.end() && p != indices.end())
+        edges.push_back ({ p->second, c->second });
+    }
+  render_dag_.assign (render_items_.size(), std::move (edges));
+}
+
+/// Claim and render runnable processors until all are claimed, rendering a
+/// processor makes its consumers runnable once their last producer is done.
+void
+AudioEngineThread::render_ready_items ()
+{
+  render_dag_.run ([this] (uint index) {
+    render_items_[index].proc->render_block (render_target_.load (std::memory_order_relaxed));
+  }, [this] () {
+    parallel_help();
+  });
+}
+
+/// Run `func (data, index)` for `n_tasks` indices, render workers help out while the caller executes tasks.
+void
+AudioEngineThread::parallel_exec (uint n_tasks, AudioEngine::ParallelTask func, void *data)
 {
-  assert_return (0 == (frames & (8 - 1)));
+  bool busy = false;
+  if (n_tasks < 2 || !render_workers_active_ || !task_busy_.compare_exchange_strong (busy, true))
+    {
+      for (uint i = 0; i < n_tasks; i++)
+        func (data, i);                 // no helpers or tasks already distributed
+      return;
+    }
+  task_func_ = func;
+  task_data_ = data;
+  task_count_ = n_tasks;
+  task_done_ = 0;
+  task_head_ = ++task_gen_ << 32;
+  for (size_t i = 0; i < std::min (render_workers_active_.load(), n_tasks - 1); i++)
+    render_sem_.post();
+  parallel_help();
+  while (task_done_.load (std::memory_order_acquire) < n_tasks)
+    cpu_relax();
+  task_head_ = task_gen_ << 32 | RENDER_CLOSED;
+  task_busy_ = false;
+}
+
+/// Claim and execute parallel tasks until all are claimed.
+void
+AudioEngineThread::parallel_help ()
+{
+  uint64 head = task_head_.load();
+  while ((head & 0xffffffff) < task_count_.load (std::memory_order_relaxed))
+    {
+      if (!task_head_.compare_exchange_weak (head, head + 1))
+        continue;                       // head was reloaded
+      task_func_ (task_data_, head & 0xffffffff);
+      task_done_.fetch_add (1, std::memory_order_release);
+      head = task_head_.load();
+    }
+}
+
+/// Account render duration against the block budget, record incidents for late blocks.
+void
+AudioEngineThread::deadline_check (uint64 render_nsecs)
+{
+  const double budget_nsecs = buffer_size_ * 1000000000.0 / transport_.samplerate;
+  const float load = render_nsecs / budget_nsecs;
+  deadline_stats_->load = load;
+  deadline_stats_->max_load = std::max (deadline_stats_->max_load, load);
+  if (ASE_ISLIKELY (load * 100 < DEADLINE_NEAR_MISS))
+    return;
+  if (load < 1.0)
+    {
+      deadline_stats_->n_near_misses += 1;
+      return;
+    }
+  deadline_stats_->n_misses += 1;
+  // find slowest processor
+  DeadlineIncident &incident = deadline_incidents_[deadline_n_incidents_++ % deadline_incidents_.size()];
+  incident = { render_stamp_, timestamp_realtime(), load };
+  uint32 max_nsecs = 0;
+  for (const RenderItem &item : render_items_)
+    if (item.proc->render_nsecs_ > max_nsecs)
+      {
+        max_nsecs = item.proc->render_nsecs_;
+        incident.level = item.level;
+        incident.proc_usecs = max_nsecs * 0.001;
+        incident.proc_aseid = item.proc->aseid_;
+      }
+  // notify about bursts of dropouts
+  if (render_stamp_ > deadline_burst_frame_ + transport_.samplerate)
+    {
+      deadline_burst_frame_ = render_stamp_;
+      deadline_burst_misses_ = 0;
+    }
+  if (++deadline_burst_misses_ == DEADLINE_BURST)
+    {
+      deadline_bursts_ += 1;
+      owner_wakeup_();
+    }
+}
+
+/// Render `frames` of all scheduled processors into the output buffer at `offset` frames.
+void
+AudioEngineThread::schedule_render (uint64 frames, uint64 offset)
+{
+  assert_return (0 == (frames & (AUDIO_BLOCK_MIN_RENDER_SIZE - 1)));
+  assert_return (offset + frames <= buffer_size_);
   // render scheduled AudioProcessor nodes
   const uint64 target_stamp = render_stamp_ + frames;
-  for (size_t l = 0; l < schedule_.size(); l++)
+  if (const size_t n_dropped = midi_arena_.reset()) [[unlikely]]
+    midi_dropped_ += n_dropped;
+  const uint n_workers = render_workers_active_;
+  const uint n_items = render_dag_.size();
+  if (n_workers && n_items > 1)
     {
-      AudioProcessor *proc = schedule_[l];
-      while (proc)
+      render_target_.store (target_stamp, std::memory_order_relaxed);
+      render_dag_.open();
+      for (size_t i = 0; i < std::min (n_workers, n_items - 1); i++)
+        render_sem_.post();
+      render_ready_items();
+      while (!render_dag_.done())
         {
-          proc->render_block (target_stamp);
-          proc = proc->sched_next_;
+          parallel_help();
+          cpu_relax();
         }
+      render_dag_.close();
     }
+  else
+    for (size_t i = 0; i < n_items; i++)
+      render_items_[i].proc->render_block (target_stamp);
   // render output buffer interleaved
-  constexpr auto MAIN_OBUS = OBusId (1);
+  float *const chbuffer = chbuffer_data_ + offset * n_channels_;
   size_t n = 0;
   for (size_t i = 0; i < oprocs_.size(); i++)
     if (oprocs_[i]->n_obuses())
       {
-        if (n++ == 0)
-          interleaved_stereo<0> (buffer_size_ * fixed_n_channels, chbuffer_data_, *oprocs_[i], MAIN_OBUS);
+        const float *srcs[MAX_CHANNELS] = {};
+        const uint n_srcs = output_floats (i, frames, srcs);
+        if (n_channels_ == 1 && n++ == 0)
+          mono_mixdown<0> (frames, chbuffer, srcs, n_srcs);
+        else if (n_channels_ == 1)
+          mono_mixdown<1> (frames, chbuffer, srcs, n_srcs);
+        else if (n++ == 0)
+          interleaved_stereo<0> (frames * n_channels_, chbuffer, srcs, n_srcs);
         else
-          interleaved_stereo<1> (buffer_size_ * fixed_n_channels, chbuffer_data_, *oprocs_[i], MAIN_OBUS);
-        static_assert (2 == fixed_n_channels);
+          interleaved_stereo<1> (frames * n_channels_, chbuffer, srcs, n_srcs);
+        static_assert (2 == MAX_CHANNELS);
       }
   if (n == 0)
-    floatfill (chbuffer_data_, 0.0, buffer_size_ * fixed_n_channels);
+    floatfill (chbuffer, 0.0, frames * n_channels_);
+  render_usecs_ = timestamp_realtime();
   render_stamp_ = target_stamp;
   transport_.advance (frames);
 }
 
+/// Rebuild the render schedule after processor or connection changes.
+void
+AudioEngineThread::schedule_update ()
+{
+  return_unless (schedule_invalid_);
+  schedule_clear();
+  for (AudioProcessorP &proc : oprocs_)
+    proc->schedule_processor();
+  schedule_flatten();
+  update_output_delays();
+  schedule_invalid_ = false;
+}
+
+/// Delay engine outputs with less latency than others, so all paths line up at the mix point.
+/// Runs on the engine thread, delay lines are (re-)allocated by update_output_delays_ml().
+void
+AudioEngineThread::update_output_delays ()
+{
+  uint max_latency = 0;
+  for (AudioProcessorP &proc : oprocs_)
+    if (proc->n_obuses())
+      max_latency = std::max (max_latency, std::min (proc->latency(), MAX_COMPENSATION));
+  bool current = output_delays_.size() == oprocs_.size();
+  for (size_t i = 0; current && i < oprocs_.size(); i++)
+    {
+      AudioProcessor *proc = oprocs_[i].get();
+      const uint delay = proc->n_obuses() ? max_latency - std::min (proc->latency(), MAX_COMPENSATION) : 0;
+      current = output_delays_[i].proc == proc && output_delays_[i].delay == delay;
+    }
+  if (!current && !output_delays_pending_.exchange (true))
+    main_rt_jobs += RtCall (*this, &AudioEngineThread::update_output_delays_ml);
+  transport_.latency = max_latency;
+}
+
+/// Allocate delay lines for the current output latencies and hand them over to the engine thread.
+void
+AudioEngineThread::update_output_delays_ml ()
+{
+  assert_return (!thread_is_engine());
+  std::vector<std::pair<AudioProcessor*,uint>> plan;
+  size_t n_oprocs = 0;
+  uint max_latency = 0;
+  do {
+    plan.reserve (n_oprocs + 8);
+    const_jobs += [&] () {
+      n_oprocs = oprocs_.size();
+      if (n_oprocs > plan.capacity())
+        return;                         // avoid allocations, retry with enough capacity
+      max_latency = 0;
+      for (AudioProcessorP &proc : oprocs_)
+        if (proc->n_obuses())
+          max_latency = std::max (max_latency, std::min (proc->latency(), MAX_COMPENSATION));
+      plan.clear();
+      for (AudioProcessorP &proc : oprocs_)
+        plan.push_back ({ proc.get(), proc->n_obuses() ? max_latency - std::min (proc->latency(), MAX_COMPENSATION) : 0 });
+    };
+  } while (plan.size() != n_oprocs);
+  EDEBUG ("AudioEngineThread::%s: output latency: %u frames\n", __func__, max_latency);
+  std::vector<OutputDelay> delays (plan.size());
+  for (size_t i = 0; i < plan.size(); i++)
+    {
+      delays[i].proc = plan[i].first;
+      delays[i].delay = plan[i].second;
+      if (delays[i].delay)
+        delays[i].lines.resize (MAX_CHANNELS * (delays[i].delay + MAX_BUFFER_SIZE), 0.0);
+    }
+  async_jobs += [this, delays = std::move (delays)] () mutable {
+    for (OutputDelay &odelay : delays)          // keep signal history of unchanged paths
+      for (OutputDelay &old : output_delays_)
+        if (odelay.delay && old.proc == odelay.proc && old.delay == odelay.delay && !old.lines.empty())
+          {
+            odelay.lines.swap (old.lines);
+            odelay.pos = old.pos;
+            break;
+          }
+    output_delays_.swap (delays);               // old lines are freed with this job on the main thread
+    output_delays_pending_ = false;
+    update_output_delays();                     // latencies may have changed meanwhile
+  };
+}
+
+/// Fetch the main output channels of `oprocs_[i]`, delayed for latency compensation if needed.
+uint
+AudioEngineThread::output_floats (size_t i, uint n_frames, const float **srcs)
+{
+  constexpr auto MAIN_OBUS = OBusId (1);
+  AudioProcessor &proc = *oprocs_[i];
+  const uint n_srcs = std::min (proc.n_ochannels (MAIN_OBUS), MAX_CHANNELS);
+  OutputDelay *odelay = i < output_delays_.size() && output_delays_[i].proc == &proc ? &output_delays_[i] : nullptr;
+  if (!odelay || !odelay->delay)
+    {
+      for (uint c = 0; c < n_srcs; c++)
+        srcs[c] = proc.ofloats (MAIN_OBUS, c);
+      return n_srcs;
+    }
+  // circular lines of `delay + MAX_BUFFER_SIZE` frames, new input is written before the delayed output is read
+  const uint length = odelay->delay + MAX_BUFFER_SIZE, wpos = odelay->pos;
+  const uint rpos = (wpos + length - odelay->delay) % length;
+  const uint wn = std::min (n_frames, length - wpos), rn = std::min (n_frames, length - rpos);
+  for (uint c = 0; c < n_srcs; c++)
+    {
+      float *line = &odelay->lines[c * length];
+      float *output = delaybuffer_data_ + c * MAX_BUFFER_SIZE;
+      const float *input = proc.ofloats (MAIN_OBUS, c);
+      fast_copy (wn, line + wpos, input);
+      fast_copy (n_frames - wn, line, input + wn);
+      fast_copy (rn, output, line + rpos);
+      fast_copy (n_frames - rn, output + rn, line);
+      srcs[c] = output;
+    }
+  odelay->pos = (wpos + n_frames) % length;
+  return n_srcs;
+}
+
 void
 AudioEngineThread::enable_output (AudioProcessor &aproc, bool onoff)
 {
@@ -244,32 +790,59 @@ AudioEngineThread::enable_output (AudioProcessor &aproc, bool onoff)
     }
 }
 
-void
-AudioEngineThread::capture_start (const String &filename, bool needsrunning)
+static WaveWriterP
+create_wave_writer (const String &filename, uint sample_rate, uint n_channels)
 {
-  const uint sample_rate = transport_.samplerate;
-  capture_stop();
-  output_needsrunning_ = needsrunning;
+  WaveWriterP wwriter;
   if (string_endswith (filename, ".wav"))
     {
-      wwriter_ = wave_writer_create_wav (sample_rate, fixed_n_channels, filename);
-      if (!wwriter_)
+      wwriter = wave_writer_create_wav (sample_rate, n_channels, filename);
+      if (!wwriter)
         printerr ("%s: failed to open file: %s\n", filename, strerror (errno));
     }
   else if (string_endswith (filename, ".opus"))
     {
-      wwriter_ = wave_writer_create_opus (sample_rate, fixed_n_channels, filename);
-      if (!wwriter_)
+      wwriter = wave_writer_create_opus (sample_rate, n_channels, filename);
+      if (!wwriter)
         printerr ("%s: failed to open file: %s\n", filename, strerror (errno));
     }
   else if (string_endswith (filename, ".flac"))
     {
-      wwriter_ = wave_writer_create_flac (sample_rate, fixed_n_channels, filename);
-      if (!wwriter_)
+      wwriter = wave_writer_create_flac (sample_rate, n_channels, filename);
+      if (!wwriter)
         printerr ("%s: failed to open file: %s\n", filename, strerror (errno));
     }
   else if (!filename.empty())
     printerr ("%s: unknown sample file: %s\n", filename, strerror (ENOSYS));
+  return wwriter;
+}
+
+/// Close capture writers, joining encoder threads may block, so this is deferred to the main thread.
+static void
+capture_close (const std::vector<AsyncWaveWriterP> &writers)
+{
+  auto close_writers = [writers] () {
+    for (const AsyncWaveWriterP &writer : writers)
+      {
+        writer->close();
+        if (writer->n_dropped())
+          printerr ("%s: capture overflow, %u frames dropped\n", writer->name(), writer->n_dropped());
+      }
+  };
+  if (this_thread_is_ase())
+    close_writers();
+  else
+    main_jobs += close_writers;
+}
+
+void
+AudioEngineThread::capture_start (AsyncWaveWriterP wwriter, bool needsrunning)
+{
+  if (wwriter_)
+    capture_close ({ wwriter_ });
+  output_needsrunning_ = needsrunning;
+  capture_overflow_ = false;
+  wwriter_ = wwriter;
 }
 
 void
@@ -277,9 +850,61 @@ AudioEngineThread::capture_stop()
 {
   if (wwriter_)
     {
-      wwriter_->close();
+      capture_close ({ wwriter_ });
       wwriter_ = nullptr;
     }
+  stems_stop();
+}
+
+void
+AudioEngineThread::stems_stop()
+{
+  if (stems_.size())
+    {
+      std::vector<AsyncWaveWriterP> writers;
+      for (const StemCapture &stem : stems_)
+        writers.push_back (stem.writer);
+      stems_.clear();
+      capture_close (writers);
+    }
+}
+
+/// Enqueue frames for encoding, account for frames lost while the encoder lags behind.
+void
+AudioEngineThread::capture_write (AsyncWaveWriter &writer, const float *frames, size_t n_frames)
+{
+  const size_t n_written = writer.write (frames, n_frames);
+  if (ASE_UNLIKELY (n_written < n_frames))
+    {
+      capture_dropped_ += n_frames - n_written;
+      if (!capture_overflow_) // report once per capture
+        {
+          capture_overflow_ = true;
+          capture_overflows_ += 1;
+          owner_wakeup_();
+        }
+    }
+}
+
+/// Capture the output of each processor in `stems` through background encoders.
+void
+AudioEngineThread::capture_stems (const std::vector<StemCapture> &stems, bool needsrunning)
+{
+  stems_stop();
+  output_needsrunning_ = needsrunning;
+  capture_overflow_ = false;
+  stems_ = stems;
+}
+
+bool
+AudioEngineThread::capture_stalled () const
+{
+  if (wwriter_ && wwriter_->writable() < buffer_size_)
+    return true;
+  for (const StemCapture &stem : stems_)
+    if (stem.writer->writable() < buffer_size_)
+      return true;
+  return false;
 }
 
 void
@@ -289,7 +914,7 @@ AudioEngineThread::run (StartQueue *sq)
   assert_return (owner_wakeup_ != nullptr);
   if (!pcm_driver_)
     pcm_driver_ = null_pcm_driver_;
-  floatfill (chbuffer_data_, 0.0, MAX_BUFFER_SIZE * fixed_n_channels);
+  floatfill (chbuffer_data_, 0.0, MAX_BUFFER_SIZE * MAX_CHANNELS);
   buffer_size_ = std::min (MAX_BUFFER_SIZE, size_t (pcm_driver_->pcm_block_length()));
   write_stamp_ = render_stamp_ - buffer_size_; // write an initial buffer of zeros
   this_thread_set_name ("AudioEngine-0"); // max 16 chars
@@ -320,6 +945,12 @@ bool
 AudioEngineThread::pcm_check_write (bool write_buffer, int64 *timeout_usecs_p)
 {
   int64 timeout_usecs = INT64_MAX;
+  if (callback_mode_)                   // PCM output is written from pcm_render()
+    {
+      if (timeout_usecs_p)
+        *timeout_usecs_p = CALLBACK_STALL_USECS;
+      return false;
+    }
   const bool can_write = pcm_driver_->pcm_check_io (&timeout_usecs) || timeout_usecs == 0;
   if (timeout_usecs_p)
     *timeout_usecs_p = timeout_usecs;
@@ -327,15 +958,174 @@ AudioEngineThread::pcm_check_write (bool write_buffer, int64 *timeout_usecs_p)
     return can_write;
   if (!can_write || write_stamp_ >= render_stamp_)
     return false;
-  pcm_driver_->pcm_write (buffer_size_ * fixed_n_channels, chbuffer_data_);
-  if (wwriter_ && fixed_n_channels == 2 && write_stamp_ < autostop_ &&
+  if (n_ichannels_)
+    pcm_input_read();                   // full duplex drivers expect read() before write()
+  pcm_driver_->pcm_write (buffer_size_ * n_channels_, chbuffer_data_);
+  output_write();
+  return false;
+}
+
+/// Fetch one block of PCM input for the next render cycle and refresh the round-trip latency.
+void
+AudioEngineThread::pcm_input_read ()
+{
+  pcm_driver_->pcm_read (buffer_size_ * n_ichannels_, ibuffer_data_);
+  if (latency_countdown_-- == 0)
+    {
+      uint rlatency = 0, wlatency = 0;
+      pcm_driver_->pcm_latency (&rlatency, &wlatency);
+      // input is consumed by the next render cycle, which adds one block
+      roundtrip_latency_ = rlatency + buffer_size_ + wlatency;
+      latency_countdown_ = transport_.samplerate / buffer_size_; // about once per second
+    }
+}
+
+/// Pass rendered buffer on to the capture file and account for written frames.
+void
+AudioEngineThread::output_write ()
+{
+  if (wwriter_ && write_stamp_ < autostop_ &&
       (!output_needsrunning_ || transport_.running()))
-    wwriter_->write (chbuffer_data_, buffer_size_);
+    capture_write (*wwriter_, chbuffer_data_, std::min (uint64 (buffer_size_), autostop_ - write_stamp_));
+  if (stems_.size() && write_stamp_ < autostop_ &&
+      (!output_needsrunning_ || transport_.running()))
+    for (const StemCapture &stem : stems_)
+      {
+        constexpr auto MAIN_OBUS = OBusId (1);
+        if (!stem.proc->n_obuses())
+          floatfill (stembuffer_data_, 0.0, buffer_size_ * n_channels_);
+        else if (n_channels_ == 1)
+          mono_mixdown<0> (buffer_size_, stembuffer_data_, *stem.proc, MAIN_OBUS);
+        else
+          interleaved_stereo<0> (buffer_size_ * n_channels_, stembuffer_data_, *stem.proc, MAIN_OBUS);
+        capture_write (*stem.writer, stembuffer_data_, std::min (uint64 (buffer_size_), autostop_ - write_stamp_));
+      }
   write_stamp_ += buffer_size_;
   if (write_stamp_ >= autostop_)
     main_loop_autostop_mt();
   assert_warn (write_stamp_ == render_stamp_);
-  return false;
+}
+
+/// Switch between PCM paced and offline rendering in between blocks.
+void
+AudioEngineThread::offline_update ()
+{
+  const bool offline = offline_ && !realtime_holds_ && transport_.running() && write_stamp_ < autostop_;
+  return_unless (offline != offline_active_ && render_stamp_ <= write_stamp_);
+  offline_active_ = offline;
+  if (offline_active_)
+    floatfill (ibuffer_data_, 0.0, MAX_BUFFER_SIZE * MAX_CHANNELS); // PCM input is not read offline
+  // offline rendering uses maximum block sizes for throughput, the PCM driver is bypassed
+  buffer_size_ = offline_active_ ? MAX_BUFFER_SIZE : std::min (MAX_BUFFER_SIZE, size_t (pcm_driver_->pcm_block_length()));
+  EDEBUG ("AudioEngineThread::%s: offline=%d enginebuffer=%d rs=%u\n", __func__, offline_active_, buffer_size_, render_stamp_);
+}
+
+/// Offline rendering is active or about to start.
+bool
+AudioEngineThread::offline_pending () const
+{
+  return offline_active_ || (offline_ && !realtime_holds_ && transport_.running() && write_stamp_ < autostop_);
+}
+
+/// In callback mode, check if the engine thread needs to take over, e.g. for offline rendering or without callbacks.
+bool
+AudioEngineThread::callback_stalled () const
+{
+  return offline_pending() || timestamp_realtime() > callback_usecs_ + CALLBACK_STALL_USECS;
+}
+
+/// Apply pending jobs and schedule changes, then render the next block if needed.
+void
+AudioEngineThread::render_cycle (bool from_callback)
+{
+  process_jobs (async_jobs_);           // apply pending modifications before render
+  schedule_update();
+  if (!from_callback)                   // block size is dictated by the callback
+    offline_update();
+  if (render_stamp_ <= write_stamp_ &&  // async jobs may have adjusted stamps
+      (from_callback || !callback_mode_ || offline_active_))
+    render_period (buffer_size_);
+}
+
+/// Render cycles from the PCM driver's process callback, using its period as block size.
+void
+AudioEngineThread::pcm_render (uint n_frames, uint n_channels, const float *const *ichannels, float *const *ochannels)
+{
+  callback_usecs_ = timestamp_realtime();
+  uint done = 0;
+  // the engine thread only holds cycle_lock_ briefly in callback mode, unless it renders offline
+  const uint64 deadline = callback_usecs_ + n_frames * uint64 (500000) / transport_.samplerate; // half a period
+  bool locked = !cycle_lock_.test_and_set (std::memory_order_acquire);
+  while (!locked && !offline_pending() && timestamp_realtime() < deadline)
+    {
+      cpu_relax();
+      locked = !cycle_lock_.test_and_set (std::memory_order_acquire);
+    }
+  if (locked)
+    {
+      audio_cycle_owner = true;
+      static_assert (CARRY_SIZE == AUDIO_BLOCK_MIN_RENDER_SIZE && MAX_BUFFER_SIZE % CARRY_SIZE == 0);
+      const uint ni = std::min (n_channels, n_ichannels_), no = std::min (n_channels, n_channels_);
+      // deliver frames rendered by the last callback
+      const uint k = std::min (ocarry_, n_frames);
+      for (uint c = 0; c < no; c++)
+        for (uint i = 0; i < k; i++)
+          ochannels[c][i] = ocarry_data_[i * MAX_CHANNELS + c];
+      ocarry_ -= k;
+      std::copy (ocarry_data_ + k * MAX_CHANNELS, ocarry_data_ + (k + ocarry_) * MAX_CHANNELS, ocarry_data_);
+      done = k;
+      uint consumed = 0;                // input frames of this callback
+      while (consumed < n_frames && callback_mode_ && !offline_pending())
+        {
+          // render carried and new input, rounded down to a multiple of CARRY_SIZE
+          const uint m = std::min (n_frames - consumed, uint (MAX_BUFFER_SIZE) - icarry_);
+          const uint nb = (icarry_ + m) / CARRY_SIZE * CARRY_SIZE;
+          if (nb == 0)
+            {
+              for (uint c = 0; c < ni; c++)
+                for (uint i = 0; i < m; i++)
+                  icarry_data_[(icarry_ + i) * MAX_CHANNELS + c] = ichannels[c][consumed + i];
+              icarry_ += m;
+              consumed += m;
+              break;
+            }
+          buffer_size_ = nb;
+          for (uint c = 0; c < ni; c++)
+            {
+              for (uint i = 0; i < icarry_; i++)
+                ibuffer_data_[i * n_ichannels_ + c] = icarry_data_[i * MAX_CHANNELS + c];
+              for (uint i = icarry_; i < nb; i++)
+                ibuffer_data_[i * n_ichannels_ + c] = ichannels[c][consumed + i - icarry_];
+            }
+          consumed += nb - icarry_;
+          icarry_ = 0;
+          render_cycle (true);
+          output_write();
+          const uint n = std::min (nb, n_frames - done);
+          for (uint c = 0; c < no; c++)
+            for (uint i = 0; i < n; i++)
+              ochannels[c][done + i] = chbuffer_data_[i * n_channels_ + c];
+          for (uint c = no; c < n_channels; c++)
+            floatfill (ochannels[c] + done, 0.0, n);
+          done += n;
+          // keep frames beyond this callback, ocarry_ + icarry_ stays below CARRY_SIZE
+          for (uint c = 0; c < no; c++)
+            for (uint i = n; i < nb; i++)
+              ocarry_data_[(ocarry_ + i - n) * MAX_CHANNELS + c] = chbuffer_data_[i * n_channels_ + c];
+          ocarry_ += nb - n;
+        }
+      if (!const_jobs_.empty()) {       // owner may be blocking for const_jobs_ execution
+        process_jobs (async_jobs_);     // apply pending modifications first
+        process_jobs (const_jobs_);
+      }
+      if (ipc_pending())
+        owner_wakeup_();                // owner needs to ipc_dispatch()
+      audio_cycle_owner = false;
+      cycle_lock_.clear (std::memory_order_release);
+    }
+  // engine thread is rendering offline, callback mode was left or the first callback lacks aligned input
+  for (uint c = 0; c < n_channels && done < n_frames; c++)
+    floatfill (ochannels[c] + done, 0.0, n_frames - done);
 }
 
 bool
@@ -350,31 +1140,63 @@ AudioEngineThread::driver_dispatcher (const LoopState &state)
     case LoopState::CHECK:
       if (atquit_triggered())
         return false;                           // stall engine once program is aborted
+      if (callback_mode_ && !callback_stalled())
+        {
+          if (timeout_usecs)
+            *timeout_usecs = CALLBACK_STALL_USECS;
+          return ipc_pending();                 // jobs and rendering are handled by pcm_render()
+        }
       if (!const_jobs_.empty() || !async_jobs_.empty())
         return true;                            // jobs pending
-      if (render_stamp_ <= write_stamp_)
+      if (render_stamp_ <= write_stamp_ && (!callback_mode_ || offline_pending()))
         return true;                            // must render
+      if (offline_active_ && capture_stalled())
+        {
+          if (timeout_usecs)
+            *timeout_usecs = 1000;
+          return false;                         // wait for encoders to catch up
+        }
+      if (offline_active_)
+        {
+          if (timeout_usecs)
+            *timeout_usecs = 0;
+          return true;                          // must write, bypassing PCM pacing
+        }
       return pcm_check_write (false, timeout_usecs);
     case LoopState::DISPATCH:
-      pcm_check_write (true);
+      if (callback_mode_ && !callback_stalled())
+        {
+          if (ipc_pending())
+            owner_wakeup_();                    // owner needs to ipc_dispatch()
+          return true;
+        }
+      if (cycle_lock_.test_and_set (std::memory_order_acquire))
+        return true;                            // pcm_render() is running
+      if (callback_mode_ && !callback_stalled()) [[unlikely]]
+        {
+          cycle_lock_.clear (std::memory_order_release);
+          return true;                          // callbacks resumed, leave jobs to pcm_render()
+        }
+      audio_cycle_owner = true;
+      if (offline_active_ && write_stamp_ < render_stamp_ && !capture_stalled())
+        {
+          offline_frames_ += buffer_size_;
+          output_write();
+        }
+      else if (!offline_active_)
+        pcm_check_write (true);
       if (render_stamp_ <= write_stamp_)
         {
-          process_jobs (async_jobs_);           // apply pending modifications before render
-          if (schedule_invalid_)
-            {
-              schedule_clear();
-              for (AudioProcessorP &proc : oprocs_)
-                proc->schedule_processor();
-              schedule_invalid_ = false;
-            }
-          if (render_stamp_ <= write_stamp_)    // async jobs may have adjusted stamps
-            schedule_render (buffer_size_);
-          pcm_check_write (true);               // minimize drop outs
+          render_cycle (false);
+          if (!offline_active_)
+            pcm_check_write (true);             // minimize drop outs
         }
       if (!const_jobs_.empty()) {               // owner may be blocking for const_jobs_ execution
         process_jobs (async_jobs_);             // apply pending modifications first
         process_jobs (const_jobs_);
       }
+      audio_cycle_owner = false;
+      cycle_lock_.clear (std::memory_order_release);
       if (ipc_pending())
         owner_wakeup_();                        // owner needs to ipc_dispatch()
       return true;                              // keep alive
@@ -394,7 +1216,8 @@ AudioEngineThread::queue_user_note (const String &channel, UserNote::Flags flags
 bool
 AudioEngineThread::ipc_pending ()
 {
-  const bool have_jobs = !trash_jobs_.empty() || !user_notes_.empty();
+  const bool have_jobs = !trash_jobs_.empty() || !user_notes_.empty() || deadline_bursts_ != deadline_bursts_noted_ ||
+                         capture_overflows_ != capture_overflows_noted_ || midi_dropped_ != midi_dropped_noted_;
   return have_jobs || AudioProcessor::enotify_pending();
 }
 
@@ -409,6 +1232,28 @@ AudioEngineThread::ipc_dispatch ()
       uj = old->next;
       delete old;
     }
+  if (deadline_bursts_ != deadline_bursts_noted_)
+    {
+      deadline_bursts_noted_ = deadline_bursts_;
+      const String msg = string_format ("# Audio Dropouts\n" "Audio rendering missed %u deadlines within one second, "
+                                        "see engine statistics for the slowest devices.", DEADLINE_BURST);
+      ASE_SERVER.user_note (msg, "driver.pcm", UserNote::TRANSIENT);
+    }
+  if (capture_overflows_ != capture_overflows_noted_)
+    {
+      capture_overflows_noted_ = capture_overflows_;
+      const String msg = string_format ("# Capture Overflow\n" "Audio encoding could not keep up with rendering, "
+                                        "the recording is missing %u frames.", capture_dropped_.load());
+      ASE_SERVER.user_note (msg, "capture", UserNote::TRANSIENT);
+    }
+  if (midi_dropped_ != midi_dropped_noted_)
+    {
+      const uint64 n_dropped = midi_dropped_ - midi_dropped_noted_;
+      midi_dropped_noted_ += n_dropped;
+      const String msg = string_format ("# MIDI Overflow\n" "Too many MIDI events within one audio block, "
+                                        "%u events were dropped.", n_dropped);
+      ASE_SERVER.user_note (msg, "midi", UserNote::TRANSIENT);
+    }
   if (AudioProcessor::enotify_pending())
     AudioProcessor::enotify_dispatch();
   EngineJobImpl *job = trash_jobs_.pop_all();
@@ -427,6 +1272,46 @@ AudioEngineThread::wakeup_thread_mt()
   event_loop_->wakeup();
 }
 
+void
+AudioEngineThread::render_worker (uint nth)
+{
+  this_thread_set_name (string_format ("AudioEngine-%u", nth)); // max 16 chars
+  sched_fast_priority (this_thread_gettid());
+  audio_render_worker = true;
+  for (;;)
+    {
+      render_sem_.wait();
+      if (render_workers_quit_)
+        break;
+      parallel_help();
+      render_ready_items();
+    }
+}
+
+void
+AudioEngineThread::update_render_workers_ml (uint n_workers)
+{
+  assert_return (this_thread_is_ase()); // main_loop thread
+  return_unless (n_workers != render_workers_.size());
+  // stop handing out work, then join old workers
+  synchronized_jobs += [this] () { render_workers_active_ = 0; };
+  render_workers_quit_ = true;
+  for (size_t i = 0; i < render_workers_.size(); i++)
+    render_sem_.post();
+  for (std::thread *thread : render_workers_)
+    {
+      thread->join();
+      delete thread;
+    }
+  render_workers_.clear();
+  render_workers_quit_ = false;
+  // start new workers
+  for (size_t i = 0; i < n_workers; i++)
+    render_workers_.push_back (new std::thread (&AudioEngineThread::render_worker, this, 1 + i));
+  render_workers_active_ = render_workers_.size();
+  EDEBUG ("AudioEngineThread::%s: using %u render workers\n", __func__, render_workers_.size());
+}
+
 void
 AudioEngineThread::start_threads_ml()
 {
@@ -435,7 +1320,7 @@ AudioEngineThread::start_threads_ml()
   assert_return (midi_proc_ == nullptr);
   schedule_.reserve (8192);
   create_processors_ml();
-  update_drivers ("null", 0, {}); // create drivers
+  update_drivers ("null", 0, {}, transport_.samplerate, n_channels_); // create drivers
   null_pcm_driver_ = driver_set_ml.null_pcm_driver;
   schedule_queue_update();
   StartQueue start_queue;
@@ -450,8 +1335,15 @@ AudioEngineThread::stop_threads_ml()
 {
   assert_return (this_thread_is_ase()); // main_loop thread
   assert_return (thread_ != nullptr);
+  synchronized_jobs += [this] () {
+    if (callback_mode_)
+      pcm_driver_->pcm_set_renderer (nullptr); // stop rendering from the driver thread
+    callback_mode_ = false;
+  };
+  update_render_workers_ml (0);
   event_loop_->quit (0);
   thread_->join();
+  capture_stop(); // flush and close capture files
   audio_engine_thread_id = {};
   auto oldthread = thread_;
   thread_ = nullptr;
@@ -528,6 +1420,29 @@ AudioEngineThread::engine_stats_string (uint64_t stats) const
     });
     s += string_format ("%s: %s (MUST_SCHEDULE)\n", pinfo.label, oprocs_[i]->debug_name());
   }
+  const double budget_usecs = buffer_size_ * 1000000.0 / transport_.samplerate;
+  s += string_format ("Render profile (%u processors, block budget %.1fus):\n", render_items_.size(), budget_usecs);
+  for (const RenderItem &item : render_items_) {
+    const RenderProfile &rp = item.proc->render_profile();
+    s += string_format ("  %-40s min=%8.1fus avg=%8.1fus p99=%8.1fus max=%8.1fus (%.1f%%)\n", item.proc->debug_name(),
+                        rp.min_usecs, rp.avg_usecs, rp.p99_usecs, rp.max_usecs, rp.avg_usecs * 100 / budget_usecs);
+  }
+  s += string_format ("Deadline misses: %u, near misses: %u, max load: %.1f%%\n", deadline_stats_->n_misses,
+                      deadline_stats_->n_near_misses, deadline_stats_->max_load * 100);
+  const size_t n_incidents = std::min (deadline_n_incidents_, uint64 (deadline_incidents_.size()));
+  for (size_t i = deadline_n_incidents_ - n_incidents; i < deadline_n_incidents_; i++) {
+    const DeadlineIncident &incident = deadline_incidents_[i % deadline_incidents_.size()];
+    s += string_format ("  %s: frame=%u load=%.1f%% level=%u slowest=%s (%.1fus)\n",
+                        timestamp_format (incident.usecs - timestamp_startup()), incident.frame, incident.load * 100,
+                        incident.level, incident.proc_aseid, incident.proc_usecs);
+  }
+  if (wwriter_ || stems_.size() || capture_dropped_)
+    s += string_format ("Capture: %u files, %u frames dropped\n", (wwriter_ ? 1 : 0) + stems_.size(), capture_dropped_.load());
+  if (midi_dropped_)
+    s += string_format ("MIDI: %u events dropped\n", midi_dropped_.load());
+  if (n_ichannels_)
+    s += string_format ("Input: %u channels, round-trip latency %u frames (%.1fms)\n", n_ichannels_,
+                        roundtrip_latency_.load(), roundtrip_latency_ * 1000.0 / transport_.samplerate);
   return s;
 }
 
@@ -540,7 +1455,11 @@ AudioEngineThread::get_project ()
 AudioEngineThread::~AudioEngineThread ()
 {
   FastMemory::Block transport_block = transport_block_; // keep alive until after ~AudioEngine
-  main_jobs += [transport_block] () { ServerImpl::instancep()->telemem_release (transport_block); };
+  FastMemory::Block deadline_block = deadline_block_;
+  main_jobs += [transport_block, deadline_block] () {
+    ServerImpl::instancep()->telemem_release (transport_block);
+    ServerImpl::instancep()->telemem_release (deadline_block);
+  };
 }
 
 AudioEngineThread::AudioEngineThread (const VoidF &owner_wakeup, uint sample_rate, SpeakerArrangement speakerarrangement,
@@ -550,14 +1469,18 @@ AudioEngineThread::AudioEngineThread (const VoidF &owner_wakeup, uint sample_rat
 {
   render_stamp_ = MAX_BUFFER_SIZE; // enforce non-0 start offset for all modules
   oprocs_.reserve (16);
-  assert_return (transport_.samplerate == 48000);
+  period_events_.reserve (4096);
+  deadline_block_ = ServerImpl::instancep()->telemem_allocate (sizeof (DeadlineStats));
+  deadline_stats_ = new (deadline_block_.block_start) DeadlineStats();
+  n_channels_ = speaker_arrangement_count_channels (speakerarrangement);
 }
 
 AudioEngine&
 make_audio_engine (const VoidF &owner_wakeup, uint sample_rate, SpeakerArrangement speakerarrangement)
 {
-  ASE_ASSERT_WARN (sample_rate == FIXED_SAMPLE_RATE);
-  ASE_ASSERT_WARN (speaker_arrangement_count_channels (speakerarrangement) == FIXED_N_CHANNELS);
+  ASE_ASSERT_WARN (sample_rate >= MIN_SAMPLERATE && sample_rate <= MAX_SAMPLERATE);
+  ASE_ASSERT_WARN (speaker_arrangement_count_channels (speakerarrangement) >= 1 &&
+                   speaker_arrangement_count_channels (speakerarrangement) <= AudioEngineThread::MAX_CHANNELS);
   FastMemory::Block transport_block = ServerImpl::instancep()->telemem_allocate (sizeof (AudioTransport));
   return *new AudioEngineThread (owner_wakeup, sample_rate, speakerarrangement, transport_block);
 }
@@ -582,6 +1505,29 @@ AudioEngine::engine_stats (uint64_t stats) const
   return strstats;
 }
 
+/// Retrieve telemetry locations of the render deadline statistics.
+TelemetryFieldS
+AudioEngine::telemetry () const
+{
+  const AudioEngineThread &impl = static_cast<const AudioEngineThread&> (*this);
+  TelemetryFieldS v;
+  v.push_back (telemetry_field ("deadline_misses", &impl.deadline_stats_->n_misses));
+  v.push_back (telemetry_field ("deadline_near_misses", &impl.deadline_stats_->n_near_misses));
+  v.push_back (telemetry_field ("render_load", &impl.deadline_stats_->load));
+  v.push_back (telemetry_field ("render_max_load", &impl.deadline_stats_->max_load));
+  return v;
+}
+
+/// Map the current time onto the frame_counter() clock, e.g. to stamp events from other threads.
+/// The result is at least frame_counter(), events are delayed by less than a block to preserve their spacing.
+uint64
+AudioEngine::frame_stamp () const
+{
+  const uint64 stamp = render_stamp_, usecs = render_usecs_, now = timestamp_realtime();
+  const uint64 elapsed = now > usecs ? (now - usecs) * sample_rate() / 1000000 : 0;
+  return stamp + std::min (elapsed, block_size() - 1);
+}
+
 uint64
 AudioEngine::block_size() const
 {
@@ -596,6 +1542,51 @@ AudioEngine::set_autostop (uint64_t nsamples)
   impl.autostop_ = nsamples;
 }
 
+/// Render as fast as possible while the transport is running, bypassing the PCM driver (needs autostop).
+void
+AudioEngine::set_offline (bool onoff)
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  assert_return (!thread_is_engine());
+  // plugins must be in offline render mode before the first offline block and vice versa
+  if (onoff)
+    ClapPluginHandle::set_render_offline (onoff);
+  impl.offline_ = onoff;
+  if (!onoff)
+    ClapPluginHandle::set_render_offline (onoff);
+}
+
+/// Check if the current block is rendered offline, only valid during AudioProcessor::render().
+bool
+AudioEngine::offline_active () const
+{
+  const AudioEngineThread &impl = static_cast<const AudioEngineThread&> (*this);
+  return impl.offline_active_;
+}
+
+/// Register a processor with a hard realtime requirement, set_offline() falls back to PCM paced rendering while any are registered.
+void
+AudioEngine::require_realtime (bool onoff)
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  if (onoff)
+    impl.realtime_holds_ += 1;
+  else
+    {
+      assert_return (impl.realtime_holds_ > 0);
+      impl.realtime_holds_ -= 1;
+    }
+  EDEBUG ("AudioEngine::%s: realtime_holds=%u\n", __func__, impl.realtime_holds_.load());
+}
+
+/// Number of frames rendered faster than realtime.
+uint64_t
+AudioEngine::offline_frames () const
+{
+  const AudioEngineThread &impl = static_cast<const AudioEngineThread&> (*this);
+  return impl.offline_frames_;
+}
+
 void
 AudioEngine::schedule_queue_update()
 {
@@ -610,6 +1601,20 @@ AudioEngine::schedule_add (AudioProcessor &aproc, uint level)
   impl.schedule_add (aproc, level);
 }
 
+void
+AudioEngine::schedule_depend (AudioProcessor &consumer, AudioProcessor &producer)
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  impl.schedule_depend (consumer, producer);
+}
+
+MidiEventArena&
+AudioEngine::midi_event_arena ()
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  return impl.midi_arena_;
+}
+
 void
 AudioEngine::enable_output (AudioProcessor &aproc, bool onoff)
 {
@@ -631,13 +1636,76 @@ AudioEngine::stop_threads()
   return impl.stop_threads_ml();
 }
 
+void
+AudioEngine::set_render_threads (uint n_threads)
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  if (n_threads == 0) // automatic
+    n_threads = std::min (8, std::max (1, this_thread_online_cpus() / 2));
+  return impl.update_render_workers_ml (std::min (n_threads, 64u) - 1);
+}
+
+/// Check if the current thread runs engine jobs and render cycles, i.e. holds the engine cycle lock.
+bool
+AudioEngine::thread_is_engine ()
+{
+  return audio_cycle_owner;
+}
+
+/// Check if the current thread renders audio, i.e. is the engine thread or a render worker.
+bool
+AudioEngine::thread_is_audio ()
+{
+  return audio_render_worker || thread_is_engine();
+}
+
+/// Execute `func (data, index)` for `n_tasks` indices in parallel, only call this from AudioProcessor::render().
+void
+AudioEngine::parallel_exec (uint n_tasks, ParallelTask func, void *data)
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  assert_return (thread_is_audio());
+  impl.parallel_exec (n_tasks, func, data);
+}
+
+/// Select how PCM periods are split into render blocks: "period", "events" or "fixed".
+void
+AudioEngine::set_block_policy (const String &policy)
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  using BlockPolicy = AudioEngineThread::BlockPolicy;
+  impl.block_policy_ = policy == "events" ? BlockPolicy::EVENTS :
+                       policy == "fixed" ? BlockPolicy::FIXED :
+                       BlockPolicy::PERIOD;
+}
+
 void
 AudioEngine::queue_capture_start (CallbackS &callbacks, const String &filename, bool needsrunning)
 {
   AudioEngineThread *impl = static_cast<AudioEngineThread*> (this);
-  String file = filename;
-  callbacks.push_back ([impl,file,needsrunning] () {
-    impl->capture_start (file, needsrunning);
+  // open file and start encoder thread outside the engine thread
+  WaveWriterP wwriter = create_wave_writer (filename, sample_rate(), impl->n_channels_);
+  AsyncWaveWriterP awriter = wwriter ? wave_writer_create_async (wwriter, impl->n_channels_) : nullptr;
+  callbacks.push_back ([impl,awriter,needsrunning] () {
+    impl->capture_start (awriter, needsrunning);
+  });
+}
+
+/// Queue capturing the main output of each of `procs` into the corresponding file of `filenames`.
+void
+AudioEngine::queue_capture_stems (CallbackS &callbacks, const StringS &filenames, const AudioProcessorS &procs, bool needsrunning)
+{
+  AudioEngineThread *impl = static_cast<AudioEngineThread*> (this);
+  assert_return (filenames.size() == procs.size());
+  std::vector<AudioEngineThread::StemCapture> stems;
+  for (size_t i = 0; i < procs.size(); i++)
+    {
+      WaveWriterP wwriter = create_wave_writer (filenames[i], sample_rate(), impl->n_channels_);
+      if (wwriter)
+        stems.push_back ({ procs[i], wave_writer_create_async (wwriter, impl->n_channels_) });
+    }
+  callbacks.push_back ([impl,stems,needsrunning] () {
+    impl->capture_stems (stems, needsrunning);
   });
 }
 
@@ -678,6 +1746,22 @@ AudioEngine::get_event_source ()
   return impl.get_event_source();
 }
 
+/// Processor providing the PCM input channels on its output bus, for consumers to connect to.
+AudioProcessorP
+AudioEngine::get_audio_input ()
+{
+  AudioEngineThread &impl = static_cast<AudioEngineThread&> (*this);
+  return impl.get_audio_input();
+}
+
+/// Frames from PCM input to PCM output, as measured via pcm_latency(), 0 without audio input.
+uint
+AudioEngine::roundtrip_latency () const
+{
+  const AudioEngineThread &impl = static_cast<const AudioEngineThread&> (*this);
+  return impl.n_ichannels_ ? impl.roundtrip_latency_.load() : 0;
+}
+
 void
 AudioEngine::set_project (ProjectImplP project)
 {
@@ -707,15 +1791,28 @@ AudioEngine::JobQueue::operator+= (const std::function<void()> &job)
 }
 
 bool
-AudioEngine::update_drivers (const String &pcm_name, uint latency_ms, const StringS &midi_prefs)
+AudioEngine::update_drivers (const String &pcm_name, uint latency_ms, const StringS &midi_prefs, uint sample_rate, uint n_channels,
+                             bool pcm_input, bool callback_mode)
 {
   AudioEngineThread &engine_thread = static_cast<AudioEngineThread&> (*this);
   DriverSet &dset = engine_thread.driver_set_ml;
   const char *const null_driver = "null";
   int must_update = 0;
   // PCM Config
-  const PcmDriverConfig pcm_config { .n_channels = engine_thread.fixed_n_channels, .mix_freq = FIXED_SAMPLE_RATE,
-                                     .block_length = AUDIO_BLOCK_MAX_RENDER_SIZE, .latency_ms = latency_ms };
+  sample_rate = CLAMP (sample_rate, MIN_SAMPLERATE, MAX_SAMPLERATE);
+  n_channels = CLAMP (n_channels, 1, AudioEngineThread::MAX_CHANNELS);
+  const PcmDriverConfig pcm_config { .n_channels = n_channels, .mix_freq = sample_rate,
+                                     .block_length = AUDIO_BLOCK_MAX_RENDER_SIZE, .latency_ms = latency_ms,
+                                     .callback_mode = callback_mode };
+  if (sample_rate != dset.mix_freq || n_channels != dset.n_channels || pcm_input != dset.pcm_input ||
+      callback_mode != dset.callback_mode) {
+    dset.mix_freq = sample_rate;
+    dset.n_channels = n_channels;
+    dset.pcm_input = pcm_input;
+    dset.callback_mode = callback_mode;
+    dset.null_pcm_driver = nullptr; // reopen all PCM drivers with new config
+    dset.pcm_name = "";
+  }
   // PCM Fallback
   if (!dset.null_pcm_driver) {
     must_update++;
@@ -729,8 +1826,11 @@ AudioEngine::update_drivers (const String &pcm_name, uint latency_ms, const Stri
     must_update++;
     dset.pcm_name = pcm_name;
     Error er = {};
+    const Driver::IODir iodir = pcm_input ? Driver::READWRITE : Driver::WRITEONLY;
     dset.pcm_driver = dset.pcm_name == null_driver ? dset.null_pcm_driver :
-                      PcmDriver::open (dset.pcm_name, Driver::WRITEONLY, Driver::WRITEONLY, pcm_config, &er);
+                      PcmDriver::open (dset.pcm_name, iodir, Driver::WRITEONLY, pcm_config, &er);
+    if (dset.pcm_driver && pcm_input && !dset.pcm_driver->readable())
+      loginf ("Audio Driver", "Failed to open audio input: %s", dset.pcm_name);
     if (!dset.pcm_driver || er != 0) {
       dset.pcm_driver = dset.null_pcm_driver;
       logerr ("Audio Driver", "Failed to open audio device: %s: %s", dset.pcm_name, ase_error_blurb (er));
@@ -787,22 +1887,31 @@ class EngineMidiInput : public AudioProcessor {
   initialize (SpeakerArrangement busses) override
   {
     prepare_event_output();
+    midi_event_output().reserve (256);
   }
   void
   reset (uint64 target_stamp) override
   {
     MidiEventOutput &estream = midi_event_output();
     estream.clear();
-    estream.reserve (256);
   }
   void
   render (uint n_frames) override
   {
     MidiEventOutput &estream = midi_event_output();
     estream.clear();
+    const AudioEngineThread &engine_thread = static_cast<const AudioEngineThread&> (engine());
+    if (engine_thread.period_split_)    // events have been fetched for the whole period
+      {
+        const uint start = engine_thread.block_offset_;
+        for (const MidiEvent &event : engine_thread.period_events_)
+          if (event.frame >= start && event.frame < start + n_frames)
+            estream.append (event.frame - start, event);
+        return;
+      }
     for (size_t i = 0; i < midi_drivers_.size(); i++)
       if (midi_drivers_[i])
-        midi_drivers_[i]->fetch_events (estream, sample_rate());
+        midi_drivers_[i]->fetch_events (estream, sample_rate(), n_frames);
   }
 public:
   MidiDriverS midi_drivers_;
@@ -811,6 +1920,99 @@ public:
   {}
 };
 
+// == EngineAudioInput ==
+class EngineAudioInput : public AudioProcessor {
+  // Processor providing PCM device input channels
+  void
+  initialize (SpeakerArrangement busses) override
+  {
+    remove_all_buses();
+    add_output_bus ("Input", SpeakerArrangement::STEREO);
+  }
+  void
+  reset (uint64 target_stamp) override
+  {}
+  void
+  render (uint n_frames) override
+  {
+    constexpr auto OUT1 = OBusId (1);
+    AudioEngineThread &engine_thread = static_cast<AudioEngineThread&> (engine());
+    const uint n_ichannels = engine_thread.n_ichannels_;
+    const float *ibuffer = engine_thread.ibuffer_data_ + engine_thread.block_offset_ * n_ichannels;
+    if (n_ichannels == 0)
+      {
+        assign_oblock (OUT1, 0, 0.0);
+        assign_oblock (OUT1, 1, 0.0);
+        return;
+      }
+    float *left = oblock (OUT1, 0);
+    if (n_ichannels == 1)
+      {
+        fast_copy (n_frames, left, ibuffer);
+        redirect_oblock (OUT1, 1, left);
+        return;
+      }
+    float *right = oblock (OUT1, 1);
+    for (uint i = 0; i < n_frames; i++)
+      {
+        left[i] = ibuffer[i * n_ichannels];
+        right[i] = ibuffer[i * n_ichannels + 1];
+      }
+  }
+public:
+  EngineAudioInput (const ProcessorSetup &psetup) :
+    AudioProcessor (psetup)
+  {}
+};
+
+/// Render a period of `frames` as one block or as several sub-blocks, according to the block policy.
+void
+AudioEngineThread::render_period (uint64 frames)
+{
+  const uint64 t0 = timestamp_benchmark();
+  // offline rendering needs throughput, stem captures need whole periods from each processor
+  const BlockPolicy policy = offline_active_ || !stems_.empty() ? BlockPolicy::PERIOD : block_policy_.load();
+  block_offset_ = 0;
+  period_split_ = false;
+  if (policy != BlockPolicy::PERIOD && frames >= 2 * SUB_BLOCK_MIN)
+    {
+      period_events_.clear();
+      for (MidiDriverP &mdriver : midi_proc_->midi_drivers_)
+        if (mdriver)
+          mdriver->fetch_events (period_events_, sample_rate(), frames);
+      if (period_events_.dropped()) [[unlikely]]
+        midi_dropped_ += period_events_.dropped();
+      period_split_ = policy == BlockPolicy::FIXED || !period_events_.empty();
+    }
+  if (!period_split_)
+    schedule_render (frames, 0);
+  else if (policy == BlockPolicy::FIXED)
+    for (uint64 n = 0; block_offset_ < frames; block_offset_ += n)
+      {
+        n = std::min (uint64 (SUB_BLOCK_SIZE), frames - block_offset_);
+        if (frames - block_offset_ - n < SUB_BLOCK_MIN)
+          n = frames - block_offset_;           // merge short remainder
+        schedule_render (n, block_offset_);
+      }
+  else // BlockPolicy::EVENTS, start a new sub-block at each event
+    {
+      for (const MidiEvent &event : period_events_)
+        {
+          const uint split = event.frame & ~(AUDIO_BLOCK_MIN_RENDER_SIZE - 1);
+          if (split >= block_offset_ + SUB_BLOCK_MIN && split + SUB_BLOCK_MIN <= frames)
+            {
+              schedule_render (split - block_offset_, block_offset_);
+              block_offset_ = split;
+            }
+        }
+      schedule_render (frames - block_offset_, block_offset_);
+    }
+  block_offset_ = 0;
+  period_split_ = false;
+  if (!offline_active_)
+    deadline_check (timestamp_benchmark() - t0);
+}
+
 void
 AudioEngineThread::create_processors_ml ()
 {
@@ -824,6 +2026,9 @@ AudioEngineThread::create_processors_ml ()
   async_jobs += [midi_proc] () {
     midi_proc->enable_engine_output (true); // MUST_SCHEDULE
   };
+  // scheduled only if consumers are connected, it must not be mixed into the engine output
+  input_proc_ = AudioProcessor::create_processor<EngineAudioInput> (*this);
+  assert_return (input_proc_);
 }
 
 AudioProcessorP
@@ -832,6 +2037,12 @@ AudioEngineThread::get_event_source ()
   return midi_proc_;
 }
 
+AudioProcessorP
+AudioEngineThread::get_audio_input ()
+{
+  return input_proc_;
+}
+
 void
 AudioEngineThread::update_driver_set (DriverSet &dset)
 {
@@ -839,12 +2050,32 @@ AudioEngineThread::update_driver_set (DriverSet &dset)
   assert_return (midi_proc_);
   // PCM Driver
   if (pcm_driver_ != dset.pcm_driver) {
+    if (pcm_driver_ && callback_mode_)
+      pcm_driver_->pcm_set_renderer (nullptr);
+    callback_mode_ = false;
     pcm_driver_.swap (dset.pcm_driver);
-    floatfill (chbuffer_data_, 0.0, MAX_BUFFER_SIZE * fixed_n_channels);
+    if (pcm_driver_->pcm_mix_freq() != transport_.samplerate || pcm_driver_->pcm_n_channels() != n_channels_)
+      reconfigure (pcm_driver_->pcm_mix_freq(), pcm_driver_->pcm_n_channels());
+    floatfill (chbuffer_data_, 0.0, MAX_BUFFER_SIZE * MAX_CHANNELS);
+    floatfill (ibuffer_data_, 0.0, MAX_BUFFER_SIZE * MAX_CHANNELS);
+    n_ichannels_ = pcm_driver_->readable() ? pcm_driver_->pcm_n_channels() : 0;
+    roundtrip_latency_ = 0;
+    latency_countdown_ = 0;
     buffer_size_ = std::min (MAX_BUFFER_SIZE, size_t (pcm_driver_->pcm_block_length()));
     write_stamp_ = render_stamp_ - buffer_size_; // write an initial buffer of zeros
-    EDEBUG ("AudioEngineThread::%s: update PCM to \"%s\": channels=%d pcmblock=%d enginebuffer=%d ws=%u rs=%u bs=%u\n", __func__,
-            dset.pcm_name, fixed_n_channels, pcm_driver_->pcm_block_length(), buffer_size_, write_stamp_, render_stamp_, buffer_size_);
+    if (dset.callback_mode && pcm_driver_->pcm_set_renderer (this))
+      {
+        write_stamp_ = render_stamp_;   // no render ahead, input and output share a process cycle
+        uint rlatency = 0, wlatency = 0;
+        pcm_driver_->pcm_latency (&rlatency, &wlatency);
+        roundtrip_latency_ = rlatency + wlatency;
+        callback_usecs_ = timestamp_realtime();
+        icarry_ = 0;
+        ocarry_ = 0;
+        callback_mode_ = true;
+      }
+    EDEBUG ("AudioEngineThread::%s: update PCM to \"%s\": channels=%d ichannels=%d pcmblock=%d enginebuffer=%d callback=%d ws=%u rs=%u bs=%u\n", __func__,
+            dset.pcm_name, n_channels_, n_ichannels_, pcm_driver_->pcm_block_length(), buffer_size_, callback_mode_, write_stamp_, render_stamp_, buffer_size_);
   }
   // MIDI Drivers
   if (midi_proc_->midi_drivers_ != dset.midi_drivers) {
@@ -853,6 +2084,31 @@ AudioEngineThread::update_driver_set (DriverSet &dset)
   }
 }
 
+/// Adjust transport and output format to the PCM driver, reset all processors for the new rate.
+void
+AudioEngineThread::reconfigure (uint sample_rate, uint n_channels)
+{
+  assert_return (sample_rate >= MIN_SAMPLERATE && sample_rate <= MAX_SAMPLERATE);
+  assert_return (n_channels >= 1 && n_channels <= MAX_CHANNELS);
+  EDEBUG ("AudioEngineThread::%s: sample_rate=%u -> %u n_channels=%u -> %u\n", __func__,
+          transport_.samplerate, sample_rate, n_channels_, n_channels);
+  if (wwriter_) // output format changes
+    {
+      printerr ("%s: stopping capture, PCM format changed: %uHz*%u -> %uHz*%u\n", wwriter_->name(),
+                transport_.samplerate, n_channels_, sample_rate, n_channels);
+      capture_stop();
+    }
+  n_channels_ = n_channels;
+  transport_.reconfigure (n_channels == 1 ? SpeakerArrangement::MONO : SpeakerArrangement::STEREO, sample_rate);
+  // enforce reset() of all scheduled processors, so they recalculate rate dependent state
+  for (const RenderItem &item : render_items_)
+    {
+      item.proc->render_stamp_ = 0;
+      item.proc->reset_state (render_stamp_);
+    }
+  schedule_queue_update();
+}
+
 // == DriverSet ==
 static Choice
 choice_from_driver_entry (const DriverEntry &e, const String &icon_keywords)
@@ -920,6 +2176,51 @@ static Preference synth_latency_pref =
         String ("descr=") + _("Processing duration between input and output of a single sample, smaller values increase CPU load"), } },
     [] (const CString&,const Value&) { apply_driver_preferences(); });
 
+static Preference block_policy_pref =
+  Preference ({
+      "driver.pcm.block_policy", _("Block Policy"), "", "period", "",
+      { { "period", _("Period"), _("Render each PCM period as a single block, lowest CPU load") },
+        { "events", _("Events"), _("Split periods at MIDI input events, for sample accurate event handling") },
+        { "fixed", _("Low Latency"), _("Render periods in small sub-blocks, for fine grained parameter changes") }, },
+      STANDARD, {
+        String ("descr=") + _("Block sizes used to render PCM periods, smaller blocks increase CPU load"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
+static Preference sample_rate_pref =
+  Preference ({
+      "driver.pcm.sample_rate", _("Sample Rate"), "", 48000, "Hz",
+      MinMaxStep { double (MIN_SAMPLERATE), double (MAX_SAMPLERATE), 0 }, STANDARD, {
+        String ("descr=") + _("Sample rate requested from the PCM driver, the engine follows the rate granted by the device"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
+static Preference n_channels_pref =
+  Preference ({
+      "driver.pcm.channels", _("Output Channels"), "", 2, "",
+      MinMaxStep { 1, 2, 1 }, STANDARD, {
+        String ("descr=") + _("Number of PCM output channels, 1 mixes the output down to mono"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
+static Preference pcm_input_pref =
+  Preference ({
+      "driver.pcm.input", _("Audio Input"), "", false, "",
+      {}, STANDARD + String (":toggle"), {
+        String ("descr=") + _("Open the PCM device for full duplex operation, so tracks can monitor and record audio input"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
+static Preference callback_mode_pref =
+  Preference ({
+      "driver.pcm.callback_mode", _("Callback Mode"), "", false, "",
+      {}, STANDARD + String (":toggle"), {
+        String ("descr=") + _("Render audio directly in the process callback of drivers that support it (JACK), this avoids buffering latency but needs reliable realtime scheduling"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
+static Preference render_threads_pref =
+  Preference ({
+      "driver.pcm.render_threads", _("Render Threads"), "", 0, "",
+      MinMaxStep { 0, 64, 1 }, STANDARD, {
+        String ("descr=") + _("Number of threads used for audio rendering, 0 selects a value based on the number of CPUs"), } },
+    [] (const CString&,const Value&) { apply_driver_preferences(); });
+
 static Preference midi1_driver_pref =
   Preference ({
       "driver.midi1.devid", _("MIDI Controller (1)"), "", "auto", "ms",
@@ -957,8 +2258,64 @@ apply_driver_preferences ()
                           StringS midis = { midi1_driver_pref.gets(), midi2_driver_pref.gets(), midi3_driver_pref.gets(), midi4_driver_pref.gets(), };
                           if (!main_config.midi_override.empty())
                             midis = { main_config.midi_override, "null", "null", "null", };
-                          main_config.engine->update_drivers (pcm_driver, synth_latency_pref.getn(), midis);
+                          main_config.engine->update_drivers (pcm_driver, synth_latency_pref.getn(), midis,
+                                                          sample_rate_pref.getn(), n_channels_pref.getn(), pcm_input_pref.getb(),
+                                                          callback_mode_pref.getb());
+                          main_config.engine->set_render_threads (render_threads_pref.getn());
+                          main_config.engine->set_block_policy (block_policy_pref.gets());
                         });
 }
 
+// == Tests ==
+TEST_INTEGRITY (render_dag_test);
+static void
+render_dag_test()
+{
+  // diamond 0 -> {1,2} -> 3, chain 3 -> 4 -> 7, 5 -> 7, 6 has no edges
+  const std::vector<std::pair<uint,uint>> edges = { { 0, 1 }, { 0, 2 }, { 1, 3 }, { 2, 3 }, { 3, 4 }, { 4, 7 }, { 5, 7 }, { 1, 3 } };
+  RenderDag dag;
+  std::atomic<uint> clock = 0;
+  std::vector<std::atomic<uint>> started (8), finished (8), runs (8);
+  auto render = [&] (uint index) {
+    started[index] = ++clock;
+    for (int i = 0; i < 1000; i++)
+      ASE_CFENCE;                       // widen the window for ordering errors
+    finished[index] = ++clock;
+    runs[index]++;
+  };
+  auto run_threads = [&] (uint n_workers) {
+    for (uint i = 0; i < dag.size(); i++)
+      runs[i] = 0;
+    dag.open();
+    std::vector<std::thread> workers;
+    for (uint i = 0; i < n_workers; i++)
+      workers.emplace_back ([&] () { dag.run (render, [] () {}); });
+    dag.run (render, [] () {});
+    while (!dag.done())
+      cpu_relax();
+    dag.close();
+    for (std::thread &thread : workers)
+      thread.join();
+  };
+  for (uint n_workers : { 0, 1, 3 })
+    {
+      dag.assign (8, edges);
+      for (size_t round = 0; round < 25; round++)
+        {
+          run_threads (n_workers);
+          for (uint i = 0; i < 8; i++)
+            TASSERT (runs[i] == 1);
+          for (const auto &[producer, consumer] : edges)
+            TASSERT (finished[producer] < started[consumer]);
+        }
+      // a single node and an empty graph
+      dag.assign (1, {});
+      run_threads (n_workers);
+      TASSERT (runs[0] == 1 && dag.done());
+      dag.assign (0, {});
+      run_threads (n_workers);
+      TASSERT (dag.size() == 0 && dag.done());
+    }
+}
+
 } // Ase
@@ -9,6 +9,7 @@
 namespace Ase {
 
 class AudioEngineThread;
+class MidiEventArena;
 
 /** Main handle for AudioProcessor administration and audio rendering.
  * Use make_audio_engine() to create a new engine and start_threads() to run
@@ -23,24 +24,31 @@ protected:
   friend class AudioProcessor;
   std::atomic<size_t> processor_count_ alignas (64) = 0;
   std::atomic<uint64_t> render_stamp_ = 0;
+  std::atomic<uint64_t> render_usecs_ = 0;
   AudioTransport     &transport_;
   explicit AudioEngine           (AudioEngineThread&, AudioTransport&);
   virtual ~AudioEngine           ();
   void     enable_output         (AudioProcessor &aproc, bool onoff);
   void     schedule_queue_update ();
   void     schedule_add          (AudioProcessor &aproc, uint level);
+  void     schedule_depend       (AudioProcessor &consumer, AudioProcessor &producer);
+  MidiEventArena& midi_event_arena ();
 public:
   // Owner-Thread API
   void            start_threads    ();
   void            stop_threads     ();
+  void            set_render_threads (uint n_threads);
+  void            set_block_policy (const String &policy);
   void            wakeup_thread_mt ();
   bool            ipc_pending      ();
   void            ipc_dispatch     ();
   AudioProcessorP get_event_source ();
+  AudioProcessorP get_audio_input  ();
   void            set_project      (ProjectImplP project);
   ProjectImplP    get_project      ();
   // MT-Safe API
   uint64_t               frame_counter       () const           { return render_stamp_; }
+  uint64_t               frame_stamp         () const;
   uint64_t               block_size          () const;
   const AudioTransport&  transport           () const           { return transport_; }
   uint                   sample_rate         () const ASE_CONST { return transport().samplerate; }
@@ -48,11 +56,23 @@ public:
   double                 inyquist            () const ASE_CONST { return transport().inyquist; }
   SpeakerArrangement     speaker_arrangement () const           { return transport().speaker_arrangement; }
   void                   set_autostop        (uint64_t nsamples);
+  void                   set_offline         (bool onoff);
+  bool                   offline_active      () const;
+  void                   require_realtime    (bool onoff);
+  uint64_t               offline_frames      () const;
   void                   queue_capture_start (CallbackS&, const String &filename, bool needsrunning);
+  void                   queue_capture_stems (CallbackS&, const StringS &filenames, const AudioProcessorS &procs, bool needsrunning);
   void                   queue_capture_stop  (CallbackS&);
-  bool                   update_drivers      (const String &pcm, uint latency_ms, const StringS &midis);
+  bool                   update_drivers      (const String &pcm, uint latency_ms, const StringS &midis,
+                                              uint sample_rate, uint n_channels, bool pcm_input = false,
+                                              bool callback_mode = false);
+  uint                   roundtrip_latency   () const;
   String                 engine_stats        (uint64_t stats) const;
-  static bool            thread_is_engine    () { return std::this_thread::get_id() == thread_id; }
+  TelemetryFieldS        telemetry           () const;
+  static bool            thread_is_engine    ();
+  static bool            thread_is_audio     ();
+  using ParallelTask   = void (*) (void *data, uint index);
+  void                   parallel_exec       (uint n_tasks, ParallelTask func, void *data);
   static const ThreadId &thread_id;
   // JobQueues
   class JobQueue {
@@ -9,6 +9,7 @@
 #include "project.hh"
 #include "loft.hh"
 #include "compress.hh"
+#include "clapplugin.hh"
 #include "internal.hh"
 #include "testing.hh"
 
@@ -17,6 +18,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <malloc.h>
+#include <fcntl.h>
 
 #undef B0 // undo pollution from termios.h
 
@@ -99,6 +101,7 @@ print_usage (bool help)
     }
   printout ("Usage: %s [OPTIONS] [project.anklang]\n", executable_name());
   printout ("  --check          Run integrity tests\n");
+  printout ("  --clap-scan <file> Print plugins of a CLAP file as JSON\n");
   printout ("  --class-tree     Print exported class tree\n");
   printout ("  --disable-randomization Test mode for deterministic tests\n");
   printout ("  --embed <fd>     Parent process socket for embedding\n");
@@ -111,6 +114,7 @@ print_usage (bool help)
   printout ("  --list-tests     List all test names\n");
   printout ("  --log2file       Enable logging to ~/.cache/anklang/ instead of stderr\n");
   printout ("  --norc           Prevent loading of any rc files\n");
+  printout ("  --offline        Render faster than realtime with -o and -t\n");
   printout ("  --play-autostart Automatically start playback of `project.anklang`\n");
   printout ("  --rand64         Produce 64bit random numbers on stdout\n");
   printout ("  --test[=test]    Run specific tests\n");
@@ -118,6 +122,7 @@ print_usage (bool help)
   printout ("  -M mididriver    Force use of <mididriver>\n");
   printout ("  -P pcmdriver     Force use of <pcmdriver>\n");
   printout ("  -o wavfile       Capture output to OPUS/FLAC/WAV file\n");
+  printout ("  -s stemsdir      Capture each track output into <stemsdir>\n");
   printout ("  -t <time>        Automatically play and stop after <time> has passed\n"); // -t <time>[{,|;}tailtime]
 }
 
@@ -186,6 +191,15 @@ parse_args (int *argcp, char **argv)
           if (arg)
             check_test_names.push_back (arg);
         }
+      else if (argv[i] == String ("--clap-scan") && i + 1 < size_t (argc))
+        {
+          argv[i++] = nullptr;
+          const int outfd = fcntl (1, F_DUPFD_CLOEXEC, 3);
+          dup2 (2, 1);                  // keep plugin output out of the scan result
+          const String json = clap_scan_probe (argv[i]) + "\n";
+          const bool written = write (outfd, json.data(), json.size()) == ssize_t (json.size());
+          _exit (written ? 0 : 1);      // skip plugin destructors
+        }
       else if (argv[i] == String ("--blake3") && i + 1 < size_t (argc))
         {
           argv[i++] = nullptr;
@@ -237,6 +251,15 @@ parse_args (int *argcp, char **argv)
           argv[i++] = nullptr;
           config.outputfile = argv[i];
         }
+      else if (argv[i] == String ("-s") && i + 1 < size_t (argc))
+        {
+          argv[i++] = nullptr;
+          config.stemsdir = argv[i];
+        }
+      else if (argv[i] == String ("--offline"))
+        {
+          config.offline = true;
+        }
       else if (argv[i] == String ("--play-autostart"))
         {
           config.play_autostart = true;
@@ -506,6 +529,10 @@ main (int argc, char *argv[])
       return 0;
     }
 
+  // scan CLAP plugins in the background
+  if (main_config.mode == MainConfig::SYNTHENGINE)
+    ClapPluginDescriptor::start_scanning();
+
   // start audio engine
   AudioEngine &audio_engine = make_audio_engine (main_loop_wakeup, 48000, SpeakerArrangement::STEREO);
   main_config_.engine = &audio_engine;
@@ -615,6 +642,51 @@ main (int argc, char *argv[])
       config.engine->async_jobs += job;
     }
 
+  // capture track stems, using the file type of the output file
+  if (config.stemsdir && preload_project)
+    {
+      const String ext = config.outputfile ? Path::split_extension (config.outputfile, true).second : ".wav";
+      if (!Path::mkdirs (config.stemsdir))
+        printerr ("%s: failed to create directory: %s\n", config.stemsdir, Ase::strerror (errno));
+      StringS filenames;
+      AudioProcessorS procs;
+      const TrackS tracks = preload_project->all_tracks();
+      for (size_t i = 0; i < tracks.size(); i++)
+        {
+          DeviceP device = tracks[i]->access_device();
+          AudioProcessorP proc = device ? device->_audio_processor() : nullptr;
+          if (!proc)
+            continue;
+          const String name = string_canonify (tracks[i]->name(), string_set_a2z() + string_set_A2Z() + "0123456789-+", "_");
+          filenames.push_back (Path::join (config.stemsdir, string_format ("%02u-%s%s", i + 1, name, ext)));
+          procs.push_back (proc);
+        }
+      std::shared_ptr<CallbackS> callbacks = std::make_shared<CallbackS>();
+      loginf ("Start stem capture: %s", config.stemsdir);
+      config.engine->queue_capture_stems (*callbacks, filenames, procs, true);
+      config.engine->async_jobs += [callbacks] () {
+        for (const auto &callback : *callbacks)
+          callback();
+      };
+    }
+
+  // render offline with progress report
+  if (config.offline && config.play_autostop >= D64MAX)
+    printerr ("%s: ignoring --offline without -t\n", executable_name());
+  else if (config.offline)
+    {
+      config.engine->set_offline (true);
+      const uint64 t0 = timestamp_realtime();
+      main_loop->exec_timer ([t0] () {
+        const double seconds = main_config.engine->offline_frames() / double (main_config.engine->sample_rate());
+        const double elapsed = (timestamp_realtime() - t0) * 0.000001;
+        if (seconds > 0)
+          printerr ("Rendering: %.1fs / %.1fs (%.0f%%, %.1fx realtime)\n", seconds, main_config.play_autostop,
+                    100.0 * std::min (1.0, seconds / main_config.play_autostop), seconds / elapsed);
+        return true;
+      }, 1000, 1000);
+    }
+
   // start auto play
   if (config.play_autostart && preload_project)
     main_loop->exec_idle ([preload_project] () {
@@ -17,6 +17,7 @@ struct MainConfig {
   String pcm_override, midi_override;
   WebSocketServer *web_socket_server = nullptr;
   const char         *outputfile = nullptr;
+  const char         *stemsdir = nullptr;
   std::vector<String> args;
   uint16 websocket_port = 0;
   int    jsonapi_logflags = 1;
@@ -25,6 +26,7 @@ struct MainConfig {
   bool   allow_randomization = true;
   bool   list_drivers = false;
   bool   play_autostart = false;
+  bool   offline = false;
   double play_autostop = D64MAX;
   enum ModeT { SYNTHENGINE, CHECK_INTEGRITY_TESTS };
   ModeT  mode = SYNTHENGINE;
@@ -2,6 +2,7 @@
 #include "ase/midievent.hh"
 #include "internal.hh"
 #include "sortnet.hh"
+#include "testing.hh"
 
 #define EDEBUG(...)     Ase::debug ("event", __VA_ARGS__)
 
@@ -174,9 +175,79 @@ make_param_value (uint param, double pvalue)
 }
 
 // == MidiEventOutput ==
-MidiEventOutput::MidiEventOutput ()
+// == MidiEventArena ==
+MidiEventArena::MidiEventArena (size_t capacity) :
+  events_ (new MidiEvent[capacity]), capacity_ (capacity)
 {}
 
+/// Allocate `n` consecutive events, returns `nullptr` if the arena is exhausted [any-thread].
+MidiEvent*
+MidiEventArena::allocate (size_t n) noexcept
+{
+  const size_t offset = used_.fetch_add (n, std::memory_order_relaxed);
+  if (ASE_ISLIKELY (offset + n <= capacity_))
+    return &events_[offset];
+  return nullptr;
+}
+
+/// Release all allocations, returns the number of events dropped since the last reset().
+size_t
+MidiEventArena::reset () noexcept
+{
+  used_.store (0, std::memory_order_relaxed);
+  return overflows_.exchange (0, std::memory_order_relaxed);
+}
+
+// == MidiEventOutput ==
+MidiEventOutput::MidiEventOutput ()
+{
+  reserve (PAGE_SIZE);
+}
+
+/// Grow the stream with storage from the arena, the own page is reused after clear().
+bool
+MidiEventOutput::grow () noexcept
+{
+  MidiEvent *const events = arena_ ? arena_->allocate (capacity_ * 2) : nullptr;
+  if (!events)
+    return false;
+  std::copy (events_, events_ + size_, events);
+  events_ = events;
+  capacity_ *= 2;
+  return true;
+}
+
+/// Remove all events, arena storage remains valid until the next MidiEventArena::reset().
+void
+MidiEventOutput::clear () noexcept
+{
+  events_ = page_.get();
+  capacity_ = page_size_;
+  size_ = 0;
+  dropped_ = 0;
+}
+
+/// Preallocate a page for `n` events, this may allocate memory and is not allowed during render().
+void
+MidiEventOutput::reserve (size_t n)
+{
+  return_unless (n > page_size_);
+  std::unique_ptr<MidiEvent[]> page (new MidiEvent[n]);
+  size_ = std::min<size_t> (size_, n);
+  std::copy (events_, events_ + size_, page.get());
+  page_.swap (page);
+  page_size_ = n;
+  events_ = page_.get();
+  capacity_ = page_size_;
+}
+
+/// Let the stream grow beyond its preallocated page via `arena` storage.
+void
+MidiEventOutput::attach_arena (MidiEventArena *arena)
+{
+  arena_ = arena;
+}
+
 /// Append an MidiEvent with conscutive `frame` time stamp.
 void
 MidiEventOutput::append (int16_t frame, const MidiEvent &event)
@@ -187,15 +258,24 @@ MidiEventOutput::append (int16_t frame, const MidiEvent &event)
 
 /// Dangerous! Append a MidiEvent while ignoring sort order, violates constraints.
 /// Returns if ensure_order() must be called due to adding an out-of-order event.
+/// Events are dropped and counted if neither page nor arena have room left.
 bool
 MidiEventOutput::append_unsorted (int16_t frame, const MidiEvent &event)
 {
-  // we discard timing information by ignoring negative frame offsets here (#26)
-  // when we implement recording, we might want to preserve the exact timestamp
+  // MIDI drivers delay input by one block to map timestamps into [0,n_frames), so
+  // negative frame offsets only occur for late events and are moved to block start (#26)
   frame = std::max<int16_t> (frame, 0);
-  const int64_t last_event_stamp = !events_.empty() ? events_.back().frame : 0;
-  events_.push_back (event);
-  events_.back().frame = frame;
+  if (ASE_UNLIKELY (size_ >= capacity_) && !grow())
+    {
+      dropped_++;
+      if (arena_)
+        arena_->overflow (1);
+      return false;
+    }
+  const int64_t last_event_stamp = size_ ? events_[size_ - 1].frame : 0;
+  events_[size_] = event;
+  events_[size_].frame = frame;
+  size_++;
   return frame < last_event_stamp;
 }
 
@@ -203,7 +283,7 @@ MidiEventOutput::append_unsorted (int16_t frame, const MidiEvent &event)
 void
 MidiEventOutput::ensure_order ()
 {
-  fixed_sort (events_.begin(), events_.end(), [] (const MidiEvent &a, const MidiEvent &b) -> bool {
+  fixed_sort (events_, events_ + size_, [] (const MidiEvent &a, const MidiEvent &b) -> bool {
     return a.frame < b.frame;
   });
 }
@@ -212,7 +292,26 @@ MidiEventOutput::ensure_order ()
 int64_t
 MidiEventOutput::last_frame () const
 {
-  return !events_.empty() ? events_.back().frame : 0;
+  return size_ ? events_[size_ - 1].frame : 0;
+}
+
+// == Tests ==
+TEST_INTEGRITY (midi_event_arena_test);
+static void
+midi_event_arena_test()
+{
+  MidiEventArena arena (MidiEventOutput::PAGE_SIZE * 2);
+  MidiEventOutput estream;
+  estream.attach_arena (&arena);
+  for (size_t i = 0; i < MidiEventOutput::PAGE_SIZE * 4; i++)
+    estream.append (i, make_note_on (0, 60, 1));
+  TASSERT (estream.size() == MidiEventOutput::PAGE_SIZE * 2);         // page + first arena chunk
+  TASSERT (estream.dropped() == MidiEventOutput::PAGE_SIZE * 2);
+  TASSERT (estream.last_frame() == MidiEventOutput::PAGE_SIZE * 2 - 1);
+  estream.clear();
+  TASSERT (estream.empty() && estream.capacity() == MidiEventOutput::PAGE_SIZE);
+  TASSERT (arena.reset() == MidiEventOutput::PAGE_SIZE * 2);
+  TASSERT (arena.reset() == 0);
 }
 
 } // Ase
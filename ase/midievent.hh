@@ -5,6 +5,7 @@
 #include <ase/memory.hh>
 #include <ase/queuemux.hh>
 #include <ase/mathutils.hh>
+#include <atomic>
 
 namespace Ase {
 
@@ -92,30 +93,59 @@ MidiEvent make_program     (uint16 chnl, uint prgrm);
 MidiEvent make_pitch_bend  (uint16 chnl, float val);
 MidiEvent make_param_value (uint param, double pvalue);
 
+/// Per-block bump allocator for MidiEventOutput storage, reset once per engine render cycle.
+class MidiEventArena {
+  std::unique_ptr<MidiEvent[]> events_;
+  const size_t                 capacity_ = 0;
+  std::atomic<size_t>          used_ = 0, overflows_ = 0;
+  ASE_CLASS_NON_COPYABLE (MidiEventArena);
+public:
+  explicit   MidiEventArena (size_t capacity);
+  MidiEvent* allocate       (size_t n) noexcept;
+  void       overflow       (size_t n) noexcept { overflows_.fetch_add (n, std::memory_order_relaxed); }
+  size_t     reset          () noexcept;
+  size_t     capacity       () const noexcept   { return capacity_; }
+};
+
+/// A contiguous range of MidiEvent structures.
+struct MidiEventRange {
+  const MidiEvent *first = nullptr, *last = nullptr;
+  const MidiEvent* begin () const noexcept { return first; }
+  const MidiEvent* end   () const noexcept { return last; }
+};
+
 /// A stream of writable MidiEvent structures.
 class MidiEventOutput {
-  std::vector<MidiEvent> events_; // TODO: use O(1) allocator
+  std::unique_ptr<MidiEvent[]> page_;           // preallocated storage
+  MidiEvent      *events_ = nullptr;            // page_ or arena_ storage
+  uint32_t        size_ = 0, capacity_ = 0, page_size_ = 0;
+  uint32_t        dropped_ = 0;
+  MidiEventArena *arena_ = nullptr;
+  bool            grow () noexcept;
+  ASE_CLASS_NON_COPYABLE (MidiEventOutput);
 public:
+  static constexpr size_t PAGE_SIZE = 128;
   explicit         MidiEventOutput ();
   void             append          (int16_t frame, const MidiEvent &event);
-  const MidiEvent* begin           () const noexcept { return &*events_.begin(); }
-  const MidiEvent* end             () const noexcept { return &*events_.end(); }
-  size_t           size            () const noexcept { return events_.size(); }
-  bool             empty           () const noexcept { return events_.empty(); }
-  void             clear           () noexcept       { events_.clear(); }
+  const MidiEvent* begin           () const noexcept { return events_; }
+  const MidiEvent* end             () const noexcept { return events_ + size_; }
+  size_t           size            () const noexcept { return size_; }
+  bool             empty           () const noexcept { return size_ == 0; }
+  void             clear           () noexcept;
   bool             append_unsorted (int16_t frame, const MidiEvent &event);
   void             ensure_order    ();
   int64_t          last_frame      () const ASE_PURE;
-  size_t           capacity        () const noexcept    { return events_.capacity(); }
-  void             reserve         (size_t n)           { events_.reserve (n); }
-  std::vector<MidiEvent>
-  const&           vector          () { return events_; }
+  size_t           capacity        () const noexcept { return capacity_; }
+  void             reserve         (size_t n);
+  void             attach_arena    (MidiEventArena *arena);
+  size_t           dropped         () const noexcept { return dropped_; }
+  MidiEventRange   range           () const noexcept { return { begin(), end() }; }
 };
 
 /// An in-order MidiEvent reader for multiple MidiEvent sources.
 template<size_t MAXQUEUES>
-class MidiEventReader : QueueMultiplexer<MAXQUEUES,std::vector<MidiEvent>::const_iterator> {
-  using Base = QueueMultiplexer<MAXQUEUES,std::vector<MidiEvent>::const_iterator>;
+class MidiEventReader : QueueMultiplexer<MAXQUEUES,const MidiEvent*> {
+  using Base = QueueMultiplexer<MAXQUEUES,const MidiEvent*>;
   ASE_CLASS_NON_COPYABLE (MidiEventReader);
 public:
   using iterator = typename Base::iterator;
@@ -123,15 +153,15 @@ public:
   size_t   events_pending  () const { return this->count_pending(); }
   iterator begin           ()       { return this->Base::begin(); }
   iterator end             ()       { return this->Base::end(); }
-  using VectorArray = std::array<const std::vector<MidiEvent>*, MAXQUEUES>;
-  /*ctor*/ MidiEventReader (const VectorArray &midi_event_vector_array = VectorArray());
+  using RangeArray = std::array<const MidiEventRange*, MAXQUEUES>;
+  /*ctor*/ MidiEventReader (const RangeArray &midi_event_range_array = RangeArray());
 };
 
 // == MidiEventReader ==
 template<size_t MAXQUEUES>
-MidiEventReader<MAXQUEUES>::MidiEventReader (const VectorArray &midi_event_vector_array)
+MidiEventReader<MAXQUEUES>::MidiEventReader (const RangeArray &midi_event_range_array)
 {
-  assign (midi_event_vector_array);
+  assign (midi_event_range_array);
 }
 
 inline int
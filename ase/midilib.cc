@@ -122,7 +122,7 @@ public:
     MidiEventInput evinput = midi_event_input(); // treat MIDI input as MIDI through
     MidiEventOutput &evout = midi_event_output(); // needs prepare_event_output()
     const int64 begin_tick = transport.current_tick;
-    const int64 end_tick = transport.current_tick + transport.sample_to_tick (n_frames);
+    const int64 end_tick = transport.tick_from_frame (n_frames);
     const int64 bpm = transport.current_bpm;
     // flush NOTE_OFF events
     if (ASE_UNLIKELY (must_flush || bpm <= 0))
@@ -145,7 +145,7 @@ public:
       {
         TickEvent tnote = future_stack.back();
         future_stack.pop_back();
-        const int64 frame = transport.sample_from_tick (tnote.tick - begin_tick);
+        const int64 frame = transport.frame_from_tick (tnote.tick);
         assert_paranoid (frame >= 0 && frame <= 4095);
         MDEBUG ("POP: t=%d ev=%s f=%d\n", tnote.tick, tnote.event.to_string(), frame);
         evout.append_unsorted (frame, tnote.event);
@@ -166,11 +166,11 @@ public:
                generator_start_ + feed_->generators[position_->current].play_position() < end_tick)
           {
             // handler for incoming events
-            auto qevent = [begin_tick, end_tick, &transport, &evout, this] (int64 cliptick, MidiEvent &event) {
+            auto qevent = [end_tick, &transport, &evout, this] (int64 cliptick, MidiEvent &event) {
               const int64 etick = generator_start_ + cliptick; // Generator tick to Engine tick
               if (etick < end_tick)
                 {
-                  const int64 frame = transport.sample_from_tick (etick - begin_tick);
+                  const int64 frame = transport.frame_from_tick (etick);
                   assert_paranoid (frame >= 0 && frame <= 4095);
                   // interleave with earlier MIDI through events
                   evout.append_unsorted (frame, event);
@@ -180,7 +180,7 @@ public:
                 {
                   TickEvent future_event { etick, event };
                   Aux::insert_sorted (future_stack, future_event, backward_cmp_ticks);
-                  MDEBUG ("FUT: t=%d ev=%s f=%d\n", etick, event.to_string(), transport.sample_from_tick (etick - begin_tick));
+                  MDEBUG ("FUT: t=%d ev=%s f=%d\n", etick, event.to_string(), transport.frame_from_tick (etick));
                 }
             };
             // generate events for this block
@@ -194,9 +194,10 @@ public:
                 position_->current = feed_->scout.advance (position_->current);
                 if (position_->current >= 0)
                   {
+                    int32 bar = transport.current_bar;
                     generator_start_ = transport.current_bar_tick;
                     while (generator_start_ < play_point)
-                      generator_start_ += transport.tick_sig.bar_ticks();
+                      generator_start_ = transport.tempo_map.bar_to_tick (++bar);
                     feed_->generators[position_->current].jumpto (0);
                     if (feed_->generators[position_->current].done())
                       position_->current = -1;
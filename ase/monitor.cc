@@ -1,42 +1,114 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 #include "monitor.hh"
 #include "track.hh"
+#include "combo.hh"
+#include "server.hh"
 #include "jsonipc/jsonipc.hh"
 #include "internal.hh"
 
 namespace Ase {
 
+// == MonitorTap ==
+MonitorTap::MonitorTap (int32 ochannel_) :
+  ochannel (ochannel_)
+{
+  block_ = SERVER->telemem_allocate (sizeof (Fields));
+  fields_ = new (block_.block_start) Fields();
+}
+
+MonitorTap::~MonitorTap()
+{
+  fields_->~Fields();
+  fields_ = nullptr;
+  SERVER->telemem_release (block_);
+}
+
+/// Analyze `n_frames` of `samples` (nullptr for silence), called from the engine thread.
+void
+MonitorTap::process (const float *samples, uint n_frames)
+{
+  Fields &fields = *fields_;
+  for (uint i = 0; i < n_frames; i++)
+    {
+      const float v = samples ? samples[i] : 0.0;
+      window_peak_ = std::max (window_peak_, std::abs (v));
+      window_sum_ += v * v;
+      scope_sum_ += v;
+      if (++scope_count_ >= SCOPE_DECIMATION)
+        {
+          const uint pos = fields.scope_pos;
+          fields.scope[pos] = scope_sum_ * (1.0 / SCOPE_DECIMATION);
+          fields.scope_pos = pos + 1 >= SCOPE_SIZE ? 0 : pos + 1;
+          scope_sum_ = 0;
+          scope_count_ = 0;
+        }
+      if (++window_count_ >= WINDOW)
+        {
+          fields.peak = window_peak_;
+          fields.rms = std::sqrt (window_sum_ * (1.0 / WINDOW));
+          window_peak_ = 0;
+          window_sum_ = 0;
+          window_count_ = 0;
+        }
+    }
+}
+
 // == MonitorImpl ==
 JSONIPC_INHERIT (MonitorImpl, Monitor);
 
-MonitorImpl::MonitorImpl()
-{}
+MonitorImpl::MonitorImpl (DeviceP output, int32 ochannel) :
+  output_ (output), tap_ (std::make_shared<MonitorTap> (ochannel))
+{
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (output_->_audio_processor());
+  assert_return (chain);
+  chain->add_monitor (tap_);
+}
 
 MonitorImpl::~MonitorImpl()
-{}
+{
+  AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (output_->_audio_processor());
+  assert_return (chain);
+  chain->del_monitor (tap_);
+}
 
 DeviceP
-MonitorImpl::get_output () // TODO: implement
+MonitorImpl::get_output ()
 {
-  return nullptr;
+  return output_;
 }
 
 int32
-MonitorImpl::get_ochannel () // TODO: implement
+MonitorImpl::get_ochannel ()
 {
-  return -1;
+  return tap_->ochannel;
 }
 
 int64
-MonitorImpl::get_mix_freq () // TODO: implement
+MonitorImpl::get_mix_freq ()
 {
-  return 0;
+  AudioProcessorP proc = output_->_audio_processor();
+  return proc ? proc->engine().sample_rate() : 0;
 }
 
 int64
-MonitorImpl::get_frame_duration () // TODO: implement
+MonitorImpl::get_frame_duration ()
+{
+  const int64 mix_freq = get_mix_freq();
+  return mix_freq ? MonitorTap::WINDOW * int64 (1000000) / mix_freq : 0;
+}
+
+TelemetryFieldS
+MonitorImpl::telemetry () const
 {
-  return 0;
+  const MonitorTap::Fields &fields = tap_->fields();
+  TelemetryFieldS v;
+  v.push_back (telemetry_field ("peak", &fields.peak));
+  v.push_back (telemetry_field ("rms", &fields.rms));
+  v.push_back (telemetry_field ("scope_pos", &fields.scope_pos));
+  TelemetryField scope = telemetry_field ("scope", &fields.scope[0]);
+  scope.length = sizeof (fields.scope);
+  v.push_back (scope);
+  return v;
 }
 
 } // Ase
@@ -3,19 +3,49 @@
 #define __ASE_MONITOR_HH__
 
 #include <ase/gadget.hh>
+#include <ase/memory.hh>
 
 namespace Ase {
 
+/// Engine side signal analysis of a single channel, results are written into the telemetry arena.
+class MonitorTap {
+public:
+  static constexpr uint WINDOW = 512;           ///< Frames per peak/RMS value.
+  static constexpr uint SCOPE_SIZE = 256;       ///< Number of scope values.
+  static constexpr uint SCOPE_DECIMATION = 8;   ///< Frames averaged per scope value.
+  struct Fields {
+    float peak = 0;                     ///< Maximum absolute sample value of the last window.
+    float rms = 0;                      ///< Root mean square of the last window.
+    int32 scope_pos = 0;                ///< Position of the next scope value, `scope` is a ring buffer.
+    float scope[SCOPE_SIZE] = { 0, };   ///< Decimated signal values.
+  };
+  const int32      ochannel;
+  explicit         MonitorTap (int32 ochannel);
+  /*dtor*/        ~MonitorTap ();
+  void             process    (const float *samples, uint n_frames);
+  const Fields&    fields     () const { return *fields_; }
+private:
+  FastMemory::Block block_;
+  Fields          *fields_ = nullptr;
+  float            window_peak_ = 0, scope_sum_ = 0;
+  double           window_sum_ = 0;
+  uint             window_count_ = 0, scope_count_ = 0;
+};
+using MonitorTapP = std::shared_ptr<MonitorTap>;
+
 class MonitorImpl : public GadgetImpl, public virtual Monitor {
   ASE_DEFINE_MAKE_SHARED (MonitorImpl);
   friend class TrackImpl;
+  DeviceP          output_;
+  MonitorTapP      tap_;
   virtual ~MonitorImpl        ();
 public:
-  explicit MonitorImpl        ();
+  explicit MonitorImpl        (DeviceP output, int32 ochannel);
   DeviceP  get_output         () override;
   int32    get_ochannel       () override;
   int64    get_mix_freq       () override;
   int64    get_frame_duration () override;
+  TelemetryFieldS telemetry   () const override;
 };
 using MonitorImplP = std::shared_ptr<MonitorImpl>;
 
@@ -5,7 +5,9 @@
 #include "main.hh"      // feature_toggle_find
 #include "utils.hh"
 #include "engine.hh"
+#include "server.hh"
 #include "internal.hh"
+#include "testing.hh"
 #include <shared_mutex>
 
 #define PDEBUG(...)     Ase::debug ("processor", __VA_ARGS__)
@@ -93,6 +95,53 @@ AudioParams::install (const AudioParams::Map &params)
   bits = new std::atomic<uint64_t>[u] ();       // a bit array causes vastly fewer cache misses
 }
 
+// == RenderProfiler ==
+/// Summarize `n` render() durations in `nsecs` into `profile`, reorders `nsecs`.
+static void
+render_profile_summarize (RenderProfile &profile, uint32 *nsecs, uint n)
+{
+  uint32 *const p99 = nsecs + n * 99 / 100;
+  std::nth_element (nsecs, p99, nsecs + n);
+  uint64 sum = 0;
+  for (uint i = 0; i < n; i++)
+    sum += nsecs[i];
+  profile.min_usecs = *std::min_element (nsecs, p99 + 1) * 0.001;
+  profile.max_usecs = *std::max_element (p99, nsecs + n) * 0.001;
+  profile.p99_usecs = *p99 * 0.001;
+  profile.avg_usecs = sum * (0.001 / n);
+  profile.n_blocks += n;
+}
+
+/// Ring of render() durations, summarized into a RenderProfile once the ring is full.
+class AudioProcessor::RenderProfiler {
+  static constexpr uint RING_SIZE = 256;
+  FastMemory::Block block_;
+  uint32            ring_[RING_SIZE] = { 0, };      // nanoseconds
+  uint              pos_ = 0;
+public:
+  RenderProfile    *profile = nullptr;
+  RenderProfiler()
+  {
+    block_ = SERVER->telemem_allocate (sizeof (RenderProfile));
+    profile = new (block_.block_start) RenderProfile();
+  }
+  ~RenderProfiler()
+  {
+    profile->~RenderProfile();
+    profile = nullptr;
+    SERVER->telemem_release (block_);
+  }
+  void
+  add (uint32 nsecs)
+  {
+    ring_[pos_++] = nsecs;
+    if (ASE_ISLIKELY (pos_ < RING_SIZE))
+      return;
+    pos_ = 0;
+    render_profile_summarize (*profile, ring_, RING_SIZE); // ring_ order is irrelevant
+  }
+};
+
 // == AudioProcessor ==
 const String AudioProcessor::GUIONLY = ":G:r:w:";     ///< GUI READABLE WRITABLE
 const String AudioProcessor::STANDARD = ":G:S:r:w:";  ///< GUI STORAGE READABLE WRITABLE
@@ -104,6 +153,7 @@ AudioProcessor::AudioProcessor (const ProcessorSetup &psetup) :
   engine_ (psetup.engine), aseid_ (psetup.aseid)
 {
   engine_.processor_count_ += 1;
+  profiler_ = new RenderProfiler();
 }
 
 /// The destructor is called when the last std::shared_ptr<> reference drops.
@@ -115,6 +165,7 @@ AudioProcessor::~AudioProcessor ()
   MidiEventVector *t0events = nullptr;
   t0events = t0events_.exchange (t0events);
   delete t0events;
+  delete profiler_;
 }
 
 /// Convert MIDI note to Hertz according to the current MusicalTuning.
@@ -440,6 +491,54 @@ AudioProcessor::reschedule ()
   engine_.schedule_queue_update();
 }
 
+/// Report the processing delay of the main output in frames, used for delay compensation.
+void
+AudioProcessor::set_latency (uint n_frames)
+{
+  return_unless (latency_ != n_frames);
+  latency_ = n_frames;
+  reschedule(); // recalculate output delays
+}
+
+/// Retrieve the processing delay of the main output in frames, see set_latency().
+uint
+AudioProcessor::latency () const
+{
+  return latency_;
+}
+
+/** Set the number of frames that output continues after all inputs became quiescent.
+ * Once the tail has passed without new input, render() calls are skipped and outputs
+ * are redirected to zeros. The default is #TAIL_INFINITE, i.e. render() is always called.
+ */
+void
+AudioProcessor::set_tail (uint n_frames)
+{
+  tail_frames_ = n_frames;
+}
+
+/// Indicate from within render() that output stays silent until input arrives, regardless of the tail.
+void
+AudioProcessor::sleep_until_input ()
+{
+  sleeping_ = true;
+}
+
+/// Ensure the next render() call is not skipped, e.g. for input that is not seen by the AudioProcessor base.
+void
+AudioProcessor::keep_awake ()
+{
+  quiet_frames_ = 0;
+  sleeping_ = false;
+}
+
+/// MT-Safe variant of keep_awake(), e.g. after queueing input for render() from the main thread.
+void
+AudioProcessor::wakeup_mt ()
+{
+  wakeup_.store (true, std::memory_order_release);
+}
+
 /// Configure if the main output of this module is mixed into the engine output.
 void
 AudioProcessor::enable_engine_output (bool onoff)
@@ -469,6 +568,7 @@ AudioProcessor::prepare_event_output ()
     estreams_ = new EventStreams();
   assert_return (estreams_->has_event_output == false);
   estreams_->has_event_output = true;
+  estreams_->midi_event_output.attach_arena (&engine_.midi_event_arena());
 }
 
 /// Disconnect event input if a connection is present.
@@ -800,6 +900,59 @@ AudioProcessor::schedule_processor()
   return level + 1;
 }
 
+/// Schedule `producer` as dependency that must be rendered before `this`.
+uint
+AudioProcessor::schedule_processor (AudioProcessor &producer)
+{
+  engine_.schedule_depend (*this, producer);
+  return producer.schedule_processor();
+}
+
+/// Track quiescence of all inputs, returns if render() can be skipped because the tail has passed.
+/// Input buffers are only scanned for silence here, i.e. for processors that can sleep.
+bool
+AudioProcessor::skip_render (uint n_frames, bool has_events)
+{
+  if (ASE_ISLIKELY (tail_frames_ == TAIL_INFINITE && !sleeping_))
+    return false;
+  constexpr float SILENCE_LEVEL = 1e-8; // -160dB
+  bool quiet = !has_events && !(wakeup_.load (std::memory_order_relaxed) && wakeup_.exchange (false));
+  if (quiet && estreams_ && estreams_->oproc && estreams_->oproc->estreams_)
+    quiet = estreams_->oproc->estreams_->midi_event_output.empty();
+  for (size_t i = 0; quiet && i < n_ibuses(); i++)
+    {
+      const IOBus &ibus = iobus (IBusId (1 + i));
+      if (!ibus.oproc)
+        continue;                       // unconnected inputs read zeros
+      const IOBus &obus = ibus.oproc->iobus (ibus.obusid);
+      for (size_t c = 0; quiet && c < obus.fbuffer_count; c++)
+        {
+          const float *buffer = ibus.oproc->fbuffers_[obus.fbuffer_index + c].buffer;
+          quiet = buffer == const_float_zeros || abs_max (n_frames, buffer) <= SILENCE_LEVEL;
+        }
+    }
+  if (!quiet)
+    {
+      keep_awake();
+      return false;
+    }
+  const bool skip = sleeping_ || quiet_frames_ > tail_frames_; // the first quiet block is always rendered
+  quiet_frames_ = std::min (uint64 (quiet_frames_) + n_frames, uint64 (TAIL_INFINITE));
+  return skip;
+}
+
+/// Redirect all outputs to zeros, used for skipped render() calls.
+void
+AudioProcessor::zero_outputs ()
+{
+  for (size_t i = 0; i < n_obuses(); i++)
+    {
+      const IOBus &obus = iobus (OBusId (1 + i));
+      for (size_t c = 0; c < obus.fbuffer_count; c++)
+        fbuffers_[obus.fbuffer_index + c].buffer = const_float_zeros;
+    }
+}
+
 struct AudioProcessor::RenderContext {
   MidiEventVector *render_events = nullptr;
 };
@@ -817,6 +970,27 @@ void
 AudioProcessor::render (uint32 n_frames)
 {}
 
+/// Retrieve render() duration statistics, updated every few hundred blocks.
+const RenderProfile&
+AudioProcessor::render_profile () const
+{
+  return *profiler_->profile;
+}
+
+/// Retrieve telemetry locations of the render_profile() fields.
+TelemetryFieldS
+AudioProcessor::render_telemetry () const
+{
+  const RenderProfile &profile = render_profile();
+  TelemetryFieldS v;
+  v.push_back (telemetry_field ("min_usecs", &profile.min_usecs));
+  v.push_back (telemetry_field ("avg_usecs", &profile.avg_usecs));
+  v.push_back (telemetry_field ("max_usecs", &profile.max_usecs));
+  v.push_back (telemetry_field ("p99_usecs", &profile.p99_usecs));
+  v.push_back (telemetry_field ("n_blocks", &profile.n_blocks));
+  return v;
+}
+
 void
 AudioProcessor::render_block (uint64 target_stamp)
 {
@@ -826,8 +1000,19 @@ AudioProcessor::render_block (uint64 target_stamp)
   if (ASE_UNLIKELY (estreams_))
     estreams_->midi_event_output.clear();
   rc.render_events = t0events_.exchange (rc.render_events); // fetch t0events_ for rendering
+  const uint n_frames = target_stamp - render_stamp_;
+  if (ASE_UNLIKELY (skip_render (n_frames, rc.render_events)))
+    {
+      zero_outputs();
+      render_nsecs_ = 0;
+      render_stamp_ = target_stamp;
+      return;
+    }
   render_context_ = &rc;
-  render (target_stamp - render_stamp_);
+  const uint64 t0 = timestamp_benchmark();
+  render (n_frames);
+  render_nsecs_ = std::min (timestamp_benchmark() - t0, uint64 (U32MAX));
+  profiler_->add (render_nsecs_);
   render_context_ = nullptr;
   render_stamp_ = target_stamp;
   if (rc.render_events) // delete in main_thread
@@ -842,12 +1027,22 @@ AudioProcessor::render_block (uint64 target_stamp)
 AudioProcessor::MidiEventInput
 AudioProcessor::midi_event_input()
 {
-  MidiEventInput::VectorArray mev_array{};
+  MidiEventRange ranges[2];
+  MidiEventInput::RangeArray mev_array{};
   size_t n = 0;
   if (estreams_ && estreams_->oproc && estreams_->oproc->estreams_)
-    mev_array[n++] = &estreams_->oproc->estreams_->midi_event_output.vector();
+    {
+      ranges[n] = estreams_->oproc->estreams_->midi_event_output.range();
+      mev_array[n] = &ranges[n];
+      n++;
+    }
   if (render_context_->render_events)
-    mev_array[n++] = render_context_->render_events;
+    {
+      const MidiEventVector &t0events = *render_context_->render_events;
+      ranges[n] = { t0events.data(), t0events.data() + t0events.size() };
+      mev_array[n] = &ranges[n];
+      n++;
+    }
   return MidiEventInput (mev_array);
 }
 
@@ -1150,4 +1345,31 @@ AudioProcessor::enotify_pending ()
   return enotify_queue_head != enotify_queue_tail;
 }
 
+// == Tests ==
+TEST_INTEGRITY (render_profile_test);
+static void
+render_profile_test()
+{
+  // durations of 1…256µs in descending order
+  uint32 nsecs[256];
+  for (uint i = 0; i < 256; i++)
+    nsecs[i] = (256 - i) * 1000;
+  RenderProfile profile;
+  render_profile_summarize (profile, nsecs, 256);
+  TCMP (profile.min_usecs, ==, 1);
+  TCMP (profile.max_usecs, ==, 256);
+  TCMP (profile.avg_usecs, ==, 128.5);
+  TCMP (profile.p99_usecs, ==, 254);    // sorted[256 * 99 / 100]
+  TCMP (profile.n_blocks, ==, 256);
+  // constant durations with a single outlier
+  for (uint i = 0; i < 256; i++)
+    nsecs[i] = i == 17 ? 500000 : 2000;
+  render_profile_summarize (profile, nsecs, 256);
+  TCMP (profile.min_usecs, ==, 2);
+  TCMP (profile.max_usecs, ==, 500);
+  TCMP (profile.p99_usecs, ==, 2);
+  TFLOATS (profile.avg_usecs, (255 * 2 + 500) / 256.0, 0.0001);
+  TCMP (profile.n_blocks, ==, 512);
+}
+
 } // Ase
@@ -37,6 +37,15 @@ struct AudioProcessorInfo {
   CString creator_url;  ///< Internet contact of the creator.
 };
 
+/// Render time statistics of an AudioProcessor in µseconds, located in telemetry memory.
+struct RenderProfile {
+  float min_usecs = 0;  ///< Fastest render() call of the last profiling period.
+  float avg_usecs = 0;  ///< Average render() duration of the last profiling period.
+  float max_usecs = 0;  ///< Slowest render() call of the last profiling period.
+  float p99_usecs = 0;  ///< 99th percentile render() duration of the last profiling period.
+  int32 n_blocks = 0;   ///< Number of render() calls accounted so far.
+};
+
 /// Add an AudioProcessor derived type to the audio processor registry.
 template<typename T> CString register_audio_processor (const char *aseid = nullptr);
 
@@ -77,6 +86,7 @@ class AudioProcessor : public std::enable_shared_from_this<AudioProcessor>, publ
   struct IOBus;
   struct EventStreams;
   struct RenderContext;
+  class RenderProfiler;
   class FloatBuffer;
   friend class ProcessorManager;
   friend class DeviceImpl;
@@ -118,6 +128,13 @@ private:
   using MidiEventVectorAP = std::atomic<MidiEventVector*>;
   MidiEventVectorAP        t0events_ = nullptr;
   RenderContext           *render_context_ = nullptr;
+  RenderProfiler          *profiler_ = nullptr;
+  uint32                   render_nsecs_ = 0;   // duration of the last render()
+  uint32                   latency_ = 0;        // processing delay of the main output
+  uint32                   tail_frames_ = ~0u;  // output duration after inputs became quiescent
+  uint32                   quiet_frames_ = 0;   // frames rendered with quiescent inputs
+  bool                     sleeping_ = false;   // output is silent until new input arrives
+  std::atomic<bool>        wakeup_ = false;     // keep_awake() requested by another thread
   std::vector<CString>     cstrings0_, cstrings1_;
   template<class F> void modify_t0events (const F&);
   void               assign_iobufs      ();
@@ -128,6 +145,8 @@ private:
   static
   const FloatBuffer& zero_buffer        ();
   void               render_block       (uint64 target_stamp);
+  bool               skip_render        (uint n_frames, bool has_events);
+  void               zero_outputs       ();
   void               reset_state        (uint64 target_stamp);
   /*copy*/           AudioProcessor     (const AudioProcessor&) = delete;
   virtual void       render             (uint n_frames) = 0;
@@ -148,7 +167,14 @@ protected:
   uint          schedule_processor ();
   void          reschedule        ();
   virtual uint  schedule_children () { return 0; }
-  static uint   schedule_processor (AudioProcessor &p)  { return p.schedule_processor(); }
+  uint          schedule_processor (AudioProcessor &producer);
+  void          set_latency       (uint n_frames);
+  // Sleeping
+  static constexpr uint TAIL_INFINITE = ~0u;
+  void          set_tail          (uint n_frames);
+  void          sleep_until_input ();
+  void          keep_awake        ();
+  void          wakeup_mt         ();
   // Parameters
   void          install_params    (const AudioParams::Map &params);
   void          apply_event       (const MidiEvent &event);
@@ -230,6 +256,9 @@ public:
   void          connect_event_input    (AudioProcessor &oproc);
   void          disconnect_event_input ();
   void          enable_engine_output   (bool onoff);
+  uint          latency                () const;
+  const RenderProfile& render_profile  () const;
+  TelemetryFieldS      render_telemetry () const;
   // MT-Safe accessors
   static double          param_peek_mt   (const AudioProcessorP proc, Id32 paramid);
   // AudioProcessor Registry
@@ -437,6 +437,25 @@ ProjectImpl::loader_resolve (const String &hexhash)
   return "";
 }
 
+static void
+serialize (TempoMap::Tempo &tempo, WritNode &xs)
+{
+  xs["tick"] & tempo.tick;
+  xs["bpm"] & tempo.bpm;
+  xs["ramp"] & tempo.ramp;
+}
+
+static void
+serialize (TempoMap::Meter &meter, WritNode &xs)
+{
+  int32 beats_per_bar = meter.beats_per_bar, beat_unit = meter.beat_unit;
+  xs["bar"] & meter.bar;
+  xs["numerator"] & beats_per_bar;
+  xs["denominator"] & beat_unit;
+  meter.beats_per_bar = beats_per_bar;
+  meter.beat_unit = beat_unit;
+}
+
 void
 ProjectImpl::serialize (WritNode &xs)
 {
@@ -445,6 +464,13 @@ ProjectImpl::serialize (WritNode &xs)
     xs["filehashes"] & storage_->asset_hashes;
   // serrialize children
   DeviceImpl::serialize (xs);
+  // tempo and meter changes after the initial bpm and signature
+  if (xs.loadable ("tempo_changes") || (xs.in_save() && !tempo_changes_.empty()))
+    xs["tempo_changes"] & tempo_changes_;
+  if (xs.loadable ("meter_changes") || (xs.in_save() && !meter_changes_.empty()))
+    xs["meter_changes"] & meter_changes_;
+  if (xs.in_load() && (!tempo_changes_.empty() || !meter_changes_.empty()))
+    update_tempo();
   // load tracks
   if (xs.in_load())
     for (auto &xc : xs["tracks"].to_nodes())
@@ -662,6 +688,8 @@ ProjectImpl::telemetry () const
   v.push_back (telemetry_field ("current_bpm", &transport.current_bpm));
   v.push_back (telemetry_field ("current_minutes", &transport.current_minutes));
   v.push_back (telemetry_field ("current_seconds", &transport.current_seconds));
+  const TelemetryFieldS e = proc->engine().telemetry();
+  v.insert (v.end(), e.begin(), e.end());
   return v;
 }
 
@@ -725,15 +753,25 @@ ProjectImpl::denominator_ (const double *n, double *q)
   return true; // might notify invalid setter attempt
 }
 
+/// Assign tempo and meter changes that follow the initial bpm and time signature.
+void
+ProjectImpl::set_tempo_changes (const TempoMap::TempoS &tempos, const TempoMap::MeterS &meters)
+{
+  tempo_changes_ = tempos;
+  meter_changes_ = meters;
+  update_tempo();
+}
+
 void
 ProjectImpl::update_tempo ()
 {
   AudioProcessorP proc = master_processor();
   return_unless (proc);
-  const TickSignature tsig (tick_sig_);
-  auto job = [proc, tsig] () {
+  TempoMap tempo_map;
+  tempo_map.assign (tick_sig_, tempo_changes_, meter_changes_, proc->engine().sample_rate());
+  auto job = [proc, tempo_map] () mutable {
     AudioTransport &transport = const_cast<AudioTransport&> (proc->engine().transport());
-    transport.tempo (tsig);
+    transport.tempo (tempo_map); // old map is destroyed with the job
   };
   proc->engine().async_jobs += job;
 }
@@ -763,14 +801,15 @@ ProjectImpl::start_playback (double autostop)
   std::shared_ptr<CallbackS> queuep = std::make_shared<CallbackS>();
   for (auto track : tracks_)
     track->queue_cmd (*queuep, track->START);
-  const TickSignature tsig (tick_sig_);
-  auto job = [proc, queuep, tsig, autostop] () {
+  TempoMap tempo_map;
+  tempo_map.assign (tick_sig_, tempo_changes_, meter_changes_, proc->engine().sample_rate());
+  auto job = [proc, queuep, tempo_map, autostop] () mutable {
     AudioEngine &engine = proc->engine();
     const double udmax = 18446744073709549568.0; // max double exactly matching an uint64_t
-    const uint64_t s = autostop > udmax ? udmax : autostop * engine.sample_rate();
-    engine.set_autostop (s);
+    const double s = autostop * engine.sample_rate();
+    engine.set_autostop (s >= udmax - engine.frame_counter() ? U64MAX : engine.frame_counter() + uint64_t (s));
     AudioTransport &transport = const_cast<AudioTransport&> (engine.transport());
-    transport.tempo (tsig);
+    transport.tempo (tempo_map);
     transport.running (true);
     for (const auto &cmd : *queuep)
       cmd();
@@ -23,6 +23,8 @@ class ProjectImpl final : public DeviceImpl, public virtual Project {
   std::vector<TrackImplP> tracks_;
   ASE_DEFINE_MAKE_SHARED (ProjectImpl);
   TickSignature tick_sig_;
+  TempoMap::TempoS tempo_changes_;
+  TempoMap::MeterS meter_changes_;
   MusicalTuning musical_tuning_ = MusicalTuning::OD_12_TET;
   uint autoplay_timer_ = 0;
   uint undo_scopes_open_ = 0;
@@ -50,6 +52,9 @@ public:
   void                 _activate         () override;
   void                 _deactivate       () override;
   const TickSignature& signature         () const       { return tick_sig_; }
+  const TempoMap::TempoS& tempo_changes  () const       { return tempo_changes_; }
+  const TempoMap::MeterS& meter_changes  () const       { return meter_changes_; }
+  void                 set_tempo_changes (const TempoMap::TempoS &tempos, const TempoMap::MeterS &meters);
   void                 discard           () override;
   AudioProcessorP      _audio_processor  () const override;
   void                 _set_event_source (AudioProcessorP esource) override;
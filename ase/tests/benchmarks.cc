@@ -3,6 +3,7 @@
 #include "../unicode.hh"
 #include "../memory.hh"
 #include "../loft.hh"
+#include "../datautils.hh"
 #include "../internal.hh"
 #include <cmath>
 
@@ -408,4 +409,61 @@ zbench_aligned_allocator_loft_alloc()
   ase_aligned_allocator_benchloop<AllocatorType::LoftAlloc> (2654435769);
 }
 
+// == SIMD Kernels ==
+static void
+scalar_interleave2_add (size_t n_frames, float *dst, const float *src0, const float *src1)
+{
+  for (size_t i = 0; i < n_frames; i++)
+    {
+      dst[2 * i] += src0[i];
+      dst[2 * i + 1] += src1[i];
+    }
+}
+
+static float
+scalar_square_sum (uint n_values, const float *ivalues)
+{
+  float accu = 0.0;
+  for (uint i = 0; i < n_values; i++)
+    accu += ivalues[i] * ivalues[i];
+  return accu;
+}
+
+static void
+scalar_float_to_int16_clip (size_t n, const float *src, int16_t *dst)
+{
+  for (size_t i = 0; i < n; i++)
+    dst[i] = std::min (0.99999990F, std::max (src[i], -1.0F)) * 32768.;
+}
+
+TEST_BENCHMARK (simd_kernel_bench);
+static void
+simd_kernel_bench()
+{
+  constexpr size_t N = 2048, RUNS = 256;
+  std::vector<float> a (N), b (N), il (2 * N);
+  std::vector<int16_t> i16 (N);
+  for (size_t i = 0; i < N; i++)
+    {
+      a[i] = sin (i * 0.01) * 1.25;
+      b[i] = cos (i * 0.01) * 0.75;
+    }
+  volatile float sink = 0;
+  Ase::Test::Timer timer (MAXTIME);
+  auto bench = [&] (const char *what, const std::function<void()> &loop) {
+    const double bench_time = timer.benchmark (loop);
+    Ase::printerr ("  BENCH    %-28s %11.1f MSamples/s\n", what, N * RUNS / bench_time / M);
+  };
+  Ase::printerr ("  BENCH    SIMD kernels: %s\n", Ase::simd_kernel_isa());
+  bench ("scalar_interleave2_add:", [&] () { for (size_t j = 0; j < RUNS; j++) scalar_interleave2_add (N, &il[0], &a[0], &b[0]); });
+  bench ("Ase::interleave2_add:", [&] () { for (size_t j = 0; j < RUNS; j++) Ase::interleave2_add (N, &il[0], &a[0], &b[0]); });
+  bench ("scalar_square_sum:", [&] () { for (size_t j = 0; j < RUNS; j++) sink = sink + scalar_square_sum (N, &a[0]); });
+  bench ("Ase::square_sum:", [&] () { for (size_t j = 0; j < RUNS; j++) sink = sink + Ase::square_sum (N, &a[0]); });
+  bench ("scalar_float_to_int16_clip:", [&] () { for (size_t j = 0; j < RUNS; j++) scalar_float_to_int16_clip (N, &a[0], &i16[0]); });
+  bench ("Ase::float_to_int16_clip:", [&] () { for (size_t j = 0; j < RUNS; j++) Ase::float_to_int16_clip (N, &a[0], &i16[0]); });
+  std::vector<int16_t> s16 (N);
+  scalar_float_to_int16_clip (N, &a[0], &s16[0]);
+  TASSERT (s16 == i16);
+}
+
 } // Anon
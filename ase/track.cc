@@ -4,6 +4,7 @@
 #include "project.hh"
 #include "nativedevice.hh"
 #include "clip.hh"
+#include "monitor.hh"
 #include "midilib.hh"
 #include "server.hh"
 #include "main.hh"
@@ -100,6 +101,11 @@ TrackImpl::_set_parent (GadgetImpl *parent)
       assert_return (chain_);
       chain_->_set_parent (this);
       chain_->_set_event_source (midi_prod_->_audio_processor());
+      if (audio_input_)
+        {
+          audio_input_ = false;
+          audio_input (true);
+        }
     }
   else if (chain_)
     {
@@ -168,6 +174,22 @@ TrackImpl::midi_channel (int32 midichannel) // TODO: implement
   emit_notify ("midi_channel");
 }
 
+void
+TrackImpl::audio_input (bool enable)
+{
+  return_unless (enable != audio_input_);
+  audio_input_ = enable;
+  if (chain_)
+    {
+      AudioChainP chain = std::dynamic_pointer_cast<AudioChain> (chain_->_audio_processor());
+      AudioProcessorP iproc = enable ? chain->engine().get_audio_input() : nullptr;
+      chain->engine().async_jobs += [chain, iproc] () {
+        chain->set_audio_input (iproc.get());
+      };
+    }
+  emit_notify ("audio_input");
+}
+
 static constexpr const uint MAX_LAUNCHER_CLIPS = 8;
 
 ClipS
@@ -233,9 +255,10 @@ TrackImpl::access_device ()
 }
 
 MonitorP
-TrackImpl::create_monitor (int32 ochannel) // TODO: implement
+TrackImpl::create_monitor (int32 ochannel)
 {
-  return nullptr;
+  return_unless (chain_ && ochannel >= 0 && ochannel < 2, nullptr);
+  return MonitorImpl::make_shared (chain_, ochannel);
 }
 
 TelemetryFieldS
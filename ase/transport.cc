@@ -147,6 +147,207 @@ TickSignature::bar_to_tick (int32 bar) const
   return tick;
 }
 
+// == TempoMap ==
+TempoMap::TempoMap()
+{
+  assign (TickSignature(), {}, {}, 48000);
+}
+
+/// Assign the tempo and time signature at tick 0 from `tsig`, followed by `tempos` and `meters` changes.
+void
+TempoMap::assign (const TickSignature &tsig, const TempoS &tempos, const MeterS &meters, uint samplerate)
+{
+  assert_return (samplerate >= MIN_SAMPLERATE && samplerate <= MAX_SAMPLERATE);
+  tempos_.clear();
+  tempos_.push_back ({ 0, CLAMP (tsig.bpm(), MIN_BPM, MAX_BPM), false });
+  for (const Tempo &t : tempos)
+    if (t.tick > 0)
+      tempos_.push_back ({ t.tick, CLAMP (t.bpm, MIN_BPM, MAX_BPM), t.ramp });
+  std::stable_sort (tempos_.begin(), tempos_.end(), [] (const Tempo &a, const Tempo &b) { return a.tick < b.tick; });
+  meters_.clear();
+  meters_.push_back ({ 0, tsig.beats_per_bar(), tsig.beat_unit() });
+  for (const Meter &m : meters)
+    if (m.bar > 0)
+      meters_.push_back (m);
+  std::stable_sort (meters_.begin(), meters_.end(), [] (const Meter &a, const Meter &b) { return a.bar < b.bar; });
+  samplerate_ = samplerate;
+  rebuild();
+}
+
+/// Recalculate the segment tables for `samplerate`, does not allocate memory.
+void
+TempoMap::set_samplerate (uint samplerate)
+{
+  assert_return (samplerate >= MIN_SAMPLERATE && samplerate <= MAX_SAMPLERATE);
+  return_unless (samplerate != samplerate_);
+  samplerate_ = samplerate;
+  rebuild();
+}
+
+void
+TempoMap::swap (TempoMap &other)
+{
+  tempos_.swap (other.tempos_);
+  meters_.swap (other.meters_);
+  tsegments_.swap (other.tsegments_);
+  msegments_.swap (other.msegments_);
+  std::swap (samplerate_, other.samplerate_);
+}
+
+// Precompute segment start positions in ticks and samples, later changes at the same position override earlier ones.
+void
+TempoMap::rebuild ()
+{
+  const double ticks_per_sample_bpm = TRANSPORT_PPQN / (60.0 * samplerate_);
+  tsegments_.resize (tempos_.size());
+  size_t n = 0;
+  for (size_t i = 0; i < tempos_.size(); i++)
+    {
+      const Tempo &t = tempos_[i];
+      if (n && tsegments_[n - 1].tick == t.tick)
+        n--;
+      TempoSegment &seg = tsegments_[n];
+      seg.tick = t.tick;
+      seg.sample = 0;
+      if (n)
+        {
+          TempoSegment &prev = tsegments_[n - 1];
+          const double ticks = t.tick - prev.tick;
+          if (t.ramp)       // ramp linearly in time, the segment length follows from the average tempo
+            {
+              const double samples = 2.0 * ticks / (ticks_per_sample_bpm * (prev.bpm + t.bpm));
+              prev.bpm_per_sample = (t.bpm - prev.bpm) / samples;
+              prev.accel = 0.5 * ticks_per_sample_bpm * prev.bpm_per_sample;
+              seg.sample = prev.sample + samples;
+            }
+          else
+            {
+              prev.bpm_per_sample = 0;
+              prev.accel = 0;
+              seg.sample = prev.sample + ticks * prev.samples_per_tick;
+            }
+        }
+      seg.bpm = t.bpm;
+      seg.ticks_per_sample = ticks_per_sample_bpm * seg.bpm;
+      seg.samples_per_tick = 1.0 / seg.ticks_per_sample;
+      seg.bpm_per_sample = 0;
+      seg.accel = 0;
+      n++;
+    }
+  tsegments_.resize (n);
+  msegments_.resize (meters_.size());
+  n = 0;
+  for (size_t i = 0; i < meters_.size(); i++)
+    {
+      const Meter &m = meters_[i];
+      if (n && msegments_[n - 1].bar == m.bar)
+        n--;
+      MeterSegment &seg = msegments_[n];
+      seg.bar = m.bar;
+      seg.tick = n ? msegments_[n - 1].tick + (m.bar - msegments_[n - 1].bar) * int64 (msegments_[n - 1].sig.bar_ticks()) : 0;
+      seg.sig.set_signature (m.beats_per_bar, m.beat_unit);
+      n++;
+    }
+  msegments_.resize (n);
+}
+
+const TempoMap::TempoSegment&
+TempoMap::tsegment_tick (double tick) const
+{
+  auto it = std::upper_bound (tsegments_.begin() + 1, tsegments_.end(), tick,
+                              [] (double t, const TempoSegment &seg) { return t < seg.tick; });
+  return *(it - 1);
+}
+
+const TempoMap::TempoSegment&
+TempoMap::tsegment_sample (double sample) const
+{
+  auto it = std::upper_bound (tsegments_.begin() + 1, tsegments_.end(), sample,
+                              [] (double s, const TempoSegment &seg) { return s < seg.sample; });
+  return *(it - 1);
+}
+
+const TempoMap::MeterSegment&
+TempoMap::msegment_tick (int64 tick) const
+{
+  auto it = std::upper_bound (msegments_.begin() + 1, msegments_.end(), tick,
+                              [] (int64 t, const MeterSegment &seg) { return t < seg.tick; });
+  return *(it - 1);
+}
+
+const TempoMap::MeterSegment&
+TempoMap::msegment_bar (int32 bar) const
+{
+  auto it = std::upper_bound (msegments_.begin() + 1, msegments_.end(), bar,
+                              [] (int32 b, const MeterSegment &seg) { return b < seg.bar; });
+  return *(it - 1);
+}
+
+/// Calculate the position of `tick` on the sample timeline, O(log n) in the number of tempo changes.
+double
+TempoMap::sample_from_tick (double tick) const
+{
+  const TempoSegment &seg = tsegment_tick (tick);
+  const double ticks = tick - seg.tick;
+  if (ASE_ISLIKELY (seg.accel == 0) || ticks <= 0)
+    return seg.sample + ticks * seg.samples_per_tick;
+  // solve ticks = ticks_per_sample * s + accel * s² for s
+  const double a = seg.ticks_per_sample;
+  const double d = std::max (0.0, a * a + 4.0 * seg.accel * ticks);
+  return seg.sample + 2.0 * ticks / (a + std::sqrt (d));
+}
+
+/// Calculate the tick at `sample` on the sample timeline, O(log n) in the number of tempo changes.
+double
+TempoMap::sample_to_tick (double sample) const
+{
+  const TempoSegment &seg = tsegment_sample (sample);
+  const double s = sample - seg.sample;
+  if (ASE_ISLIKELY (seg.accel == 0) || s <= 0)
+    return seg.tick + s * seg.ticks_per_sample;
+  return seg.tick + s * (seg.ticks_per_sample + s * seg.accel);
+}
+
+/// Retrieve the tempo in beats per minute at `sample`.
+double
+TempoMap::bpm_at (double sample) const
+{
+  const TempoSegment &seg = tsegment_sample (sample);
+  return seg.bpm + std::max (0.0, sample - seg.sample) * seg.bpm_per_sample;
+}
+
+/// Retrieve the tempo increment per sample at `sample`, non-zero only during tempo ramps.
+double
+TempoMap::bpm_per_sample (double sample) const
+{
+  return tsegment_sample (sample).bpm_per_sample;
+}
+
+/// Retrieve the time signature in effect at `tick`, its bpm() is unset.
+const TickSignature&
+TempoMap::signature_at (int64 tick) const
+{
+  return msegment_tick (tick).sig;
+}
+
+/// Calculate bar, beat and semiquaver from tick, taking meter changes into account.
+TickSignature::Beat
+TempoMap::beat_from_tick (int64 tick) const
+{
+  const MeterSegment &seg = msegment_tick (tick);
+  TickSignature::Beat b = seg.sig.beat_from_tick (tick - seg.tick);
+  b.bar += seg.bar;
+  return b;
+}
+
+/// Calculate the start tick of `bar`, taking meter changes into account.
+int64
+TempoMap::bar_to_tick (int32 bar) const
+{
+  const MeterSegment &seg = msegment_bar (bar);
+  return seg.tick + seg.sig.bar_to_tick (bar - seg.bar);
+}
+
 // == SpeakerArrangement ==
 // Count the number of channels described by the SpeakerArrangement.
 uint8
@@ -232,7 +433,24 @@ AudioTransport::AudioTransport (SpeakerArrangement speakerarrangement, uint samp
   speaker_arrangement (speakerarrangement)
 {
   tick_sig.set_samplerate (sample_rate);
+  tempo_map.set_samplerate (sample_rate);
+  assert_return (sample_rate >= MIN_SAMPLERATE && sample_rate <= MAX_SAMPLERATE);
+  update_current();
+}
+
+/// Change sample rate and output configuration, only valid in between render() calls.
+void
+AudioTransport::reconfigure (SpeakerArrangement speakerarrangement, uint sample_rate)
+{
   assert_return (sample_rate >= MIN_SAMPLERATE && sample_rate <= MAX_SAMPLERATE);
+  samplerate = sample_rate;
+  nyquist = sample_rate / 2;
+  isamplerate = 1.0 / sample_rate;
+  inyquist = 2.0 / sample_rate;
+  speaker_arrangement = speakerarrangement;
+  tick_sig.set_samplerate (sample_rate);
+  tempo_map.set_samplerate (sample_rate);
+  current_sample = tempo_map.sample_from_tick (current_tick_d);
   update_current();
 }
 
@@ -255,31 +473,28 @@ AudioTransport::set_tick (int64 newtick)
 {
   current_tick = newtick;
   current_tick_d = current_tick;
+  current_sample = tempo_map.sample_from_tick (current_tick_d);
   update_current();
 }
 
+/// Swap in `tempomap` while preserving the current tick, the old map is left in `tempomap` for deletion.
 void
-AudioTransport::tempo (double newbpm, uint8 numerator, uint8 denominator)
+AudioTransport::tempo (TempoMap &tempomap)
 {
-  tick_sig.set_bpm (CLAMP (newbpm, MIN_BPM, MAX_BPM));
-  tick_sig.set_signature (numerator, denominator);
-  current_bpm = current_bpm ? newbpm : 0;
+  tempo_map.swap (tempomap);
+  tempo_map.set_samplerate (samplerate);
+  current_sample = tempo_map.sample_from_tick (current_tick_d);
   update_current();
 }
 
-void
-AudioTransport::tempo (const TickSignature &ticksignature)
-{
-  tempo (ticksignature.bpm(), ticksignature.beats_per_bar(), ticksignature.beat_unit());
-}
-
 void
 AudioTransport::advance (uint nsamples)
 {
   current_frame += nsamples;
   if (ISLIKELY (current_bpm > 0.0))
     {
-      current_tick_d += nsamples * tick_sig.ticks_per_sample();
+      current_sample += nsamples;
+      current_tick_d = tempo_map.sample_to_tick (current_sample);
       current_tick = current_tick_d;
       update_current();
     }
@@ -288,17 +503,25 @@ AudioTransport::advance (uint nsamples)
 void
 AudioTransport::update_current ()
 {
-  TickSignature::Beat beat = tick_sig.beat_from_tick (std::max (current_tick, 0l));
+  const int64 tick = std::max (current_tick, 0l);
+  const TickSignature &sig = tempo_map.signature_at (tick);
+  if (sig.beats_per_bar() != tick_sig.beats_per_bar() || sig.beat_unit() != tick_sig.beat_unit())
+    tick_sig.set_signature (sig.beats_per_bar(), sig.beat_unit());
+  const double bpm = tempo_map.bpm_at (current_sample);
+  if (bpm != tick_sig.bpm())
+    tick_sig.set_bpm (bpm);
+  current_bpm = current_bpm ? bpm : 0;
+  TickSignature::Beat beat = tempo_map.beat_from_tick (tick);
   current_bar = beat.bar;
   current_beat = beat.beat;
   current_semiquaver = beat.semiquaver;
   const auto old_next = next_bar_tick;
-  current_bar_tick = tick_sig.bar_to_tick (current_bar);
-  next_bar_tick = current_bar_tick + tick_sig.bar_ticks();
+  current_bar_tick = tempo_map.bar_to_tick (current_bar);
+  next_bar_tick = tempo_map.bar_to_tick (current_bar + 1);
 
-  TickSignature::Time time = tick_sig.time_from_tick (current_tick);
-  current_minutes = time.minutes;
-  current_seconds = time.seconds;
+  const double seconds = current_sample * isamplerate;
+  current_minutes = std::floor (seconds * (1.0 / 60.0));
+  current_seconds = seconds - current_minutes * 60.0;
 
   if (old_next != next_bar_tick && false)
     printerr ("%3d.%2d.%5.2f %02d:%06.3f frame=%d tick=%d next=%d bpm=%d sig=%d/%d ppqn=%d pps=%f rate=%d\n",
@@ -348,4 +571,35 @@ transport_tests()
   TCMP (ts.bar_to_tick (tb.bar), ==, ts.beat_to_tick (tb));
 }
 
+TEST_INTEGRITY (tempo_map_tests);
+
+static void
+tempo_map_tests()
+{
+  const int64 bar = 4 * TRANSPORT_PPQN;
+  TempoMap tmap;
+  // 120bpm, step to 60bpm at bar 4, ramp to 120bpm until bar 8, step to 30bpm at bar 9, 3/4 from bar 2
+  tmap.assign (TickSignature (120, 4, 4), { { 4 * bar, 60, false }, { 8 * bar, 120, true }, { 9 * bar, 30, false } },
+               { { 2, 3, 4 } }, 48000);
+  TASSERT (std::abs (tmap.sample_from_tick (bar) - 96000) < 1e-6);
+  TASSERT (std::abs (tmap.sample_from_tick (4 * bar) - 4 * 96000) < 1e-6);
+  // 16 beats ramped from 60 to 120bpm average 90bpm, i.e. 10.667 seconds
+  const double ramp_end = 4 * 96000 + 512000;
+  TASSERT (std::abs (tmap.sample_from_tick (8 * bar) - ramp_end) < 1e-6);
+  TASSERT (std::abs (tmap.sample_from_tick (10 * bar) - (ramp_end + 96000 + 384000)) < 1e-6);
+  TASSERT (std::abs (tmap.bpm_at (4 * 96000 + 256000) - 90) < 1e-9);
+  TASSERT (tmap.bpm_at (ramp_end + 1000) == 120);
+  for (int64 tick = -bar; tick < 10 * bar; tick += 7777777)
+    TASSERT (std::abs (tmap.sample_to_tick (tmap.sample_from_tick (tick)) - tick) < 1);
+  tmap.set_samplerate (96000);
+  TASSERT (std::abs (tmap.sample_from_tick (8 * bar) - 2 * ramp_end) < 1e-6);
+  // meter changes
+  TCMP (tmap.bar_to_tick (2), ==, 2 * bar);
+  TCMP (tmap.bar_to_tick (4), ==, 2 * bar + 2 * 3 * TRANSPORT_PPQN);
+  const TickSignature::Beat b = tmap.beat_from_tick (2 * bar + 4 * TRANSPORT_PPQN);
+  TCMP (b.bar, ==, 3);
+  TCMP (b.beat, ==, 1);
+  TCMP (tmap.beat_from_tick (bar + TRANSPORT_PPQN).beat, ==, 1);
+}
+
 } // Anon
@@ -109,18 +109,76 @@ public:
   TickSignature& operator=      (const TickSignature &src);
 };
 
+/// Tempo and meter changes with precomputed segment tables for tick and sample conversions.
+class TempoMap {
+public:
+  struct Tempo {
+    int64  tick = 0;            ///< Position of the tempo change.
+    double bpm = 0;             ///< Tempo in beats per minute reached at `tick`.
+    bool   ramp = false;        ///< Approach `bpm` linearly in time from the previous tempo instead of a step change.
+  };
+  struct Meter {
+    int32  bar = 0;             ///< Bar at which the time signature takes effect.
+    uint8  beats_per_bar = 4;   ///< Upper numeral of the time signature.
+    uint8  beat_unit = 4;       ///< Lower numeral of the time signature.
+  };
+  using TempoS = std::vector<Tempo>;
+  using MeterS = std::vector<Meter>;
+private:
+  struct TempoSegment {
+    int64  tick = 0;            // segment start
+    double sample = 0;          // segment start on the sample timeline
+    double bpm = 0;             // tempo at segment start
+    double ticks_per_sample = 0;
+    double samples_per_tick = 0;
+    double bpm_per_sample = 0;  // tempo ramp, 0 for constant tempo
+    double accel = 0;           // ticks per sample², 0 for constant tempo
+  };
+  struct MeterSegment {
+    int64  tick = 0;
+    int32  bar = 0;
+    TickSignature sig;
+  };
+  TempoS                    tempos_;
+  MeterS                    meters_;
+  std::vector<TempoSegment> tsegments_;
+  std::vector<MeterSegment> msegments_;
+  uint                      samplerate_ = 0;
+  void                      rebuild         ();
+  const TempoSegment&       tsegment_tick   (double tick) const;
+  const TempoSegment&       tsegment_sample (double sample) const;
+  const MeterSegment&       msegment_tick   (int64 tick) const;
+  const MeterSegment&       msegment_bar    (int32 bar) const;
+public:
+  void                assign           (const TickSignature &tsig, const TempoS &tempos, const MeterS &meters, uint samplerate);
+  void                set_samplerate   (uint samplerate);
+  void                swap             (TempoMap &other);
+  const TempoS&       tempos           () const { return tempos_; }
+  const MeterS&       meters           () const { return meters_; }
+  double              sample_from_tick (double tick) const;
+  double              sample_to_tick   (double sample) const;
+  double              bpm_at           (double sample) const;
+  double              bpm_per_sample   (double sample) const;
+  const TickSignature& signature_at    (int64 tick) const;
+  TickSignature::Beat beat_from_tick   (int64 tick) const;
+  int64               bar_to_tick      (int32 bar) const;
+  explicit            TempoMap         ();
+};
+
 /// Transport information for AudioSignal processing.
 struct AudioTransport {
   static constexpr int64 ppqn = TRANSPORT_PPQN;
-  const uint     samplerate;    ///< Sample rate (mixing frequency) in Hz used for rendering.
-  const uint     nyquist;       ///< Half the `samplerate`.
-  const double   isamplerate;   ///< Precalculated `1.0 / samplerate`.
-  const double   inyquist;      ///< Precalculated `1.0 / nyquist`.
-  const SpeakerArrangement speaker_arrangement; ///< Audio output configuration.
-  // uint32 gap
-  TickSignature  tick_sig;
+  uint           samplerate;    ///< Sample rate (mixing frequency) in Hz used for rendering.
+  uint           nyquist;       ///< Half the `samplerate`.
+  double         isamplerate;   ///< Precalculated `1.0 / samplerate`.
+  double         inyquist;      ///< Precalculated `1.0 / nyquist`.
+  SpeakerArrangement speaker_arrangement; ///< Audio output configuration.
+  uint           latency = 0;   ///< Processing delay of the engine output in frames, after delay compensation.
+  TickSignature  tick_sig;      ///< Tempo and time signature at the current position.
+  TempoMap       tempo_map;     ///< Tempo and meter changes of the project.
   int64          current_frame = 0;             ///< Number of sample frames processed since playback start.
   int64          current_tick = 0;
+  double         current_sample = 0;            ///< Position of *current_tick* on the *tempo_map* sample timeline
   __attribute__ ((aligned (64)))        // align memory for project telemetry fields
   double         current_tick_d = 0;            ///< Current position measured via *TRANSPORT_PPQN*
   int32          current_bar =  0;              ///< Bar of *current_tick* position
@@ -133,15 +191,15 @@ struct AudioTransport {
   int64          next_bar_tick = 0;
   bool     running        () const      { return current_bpm != 0; }
   void     running        (bool r);
-  void     tempo          (double newbpm, uint8 newnumerator, uint8 newdenominator);
-  void     tempo          (const TickSignature &ticksignature);
+  void     tempo          (TempoMap &tempomap);
   void     set_tick       (int64 newtick);
   void     set_beat       (TickSignature::Beat b);
   void     advance        (uint nsamples);
+  void     reconfigure    (SpeakerArrangement speakerarrangement, uint samplerate);
   void     update_current ();
   explicit AudioTransport (SpeakerArrangement speakerarrangement, uint samplerate);
-  int64    sample_to_tick  (int64 sample) const { return tick_sig.sample_to_tick (sample); }
-  int64    sample_from_tick (int64 tick) const  { return tick_sig.sample_from_tick (tick); }
+  int64    frame_from_tick (int64 tick) const;
+  int64    tick_from_frame (int64 frame) const;
 };
 
 // == Implementations ==
@@ -157,6 +215,20 @@ TickSignature::sample_from_tick (int64 tick) const
   return sample_per_ticks_ * tick;
 }
 
+/// Frame offset of `tick` relative to the current position.
+inline int64
+AudioTransport::frame_from_tick (int64 tick) const
+{
+  return tempo_map.sample_from_tick (tick) - current_sample;
+}
+
+/// Tick at `frame` offset from the current position.
+inline int64
+AudioTransport::tick_from_frame (int64 frame) const
+{
+  return tempo_map.sample_to_tick (current_sample + frame);
+}
+
 } // Ase
 
 #endif // __ASE_TRANSPORT_HH__
@@ -5,6 +5,7 @@
 #include "platform.hh"
 #include "randomhash.hh"
 #include "internal.hh"
+#include "testing.hh"
 #include <cstring>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -240,6 +241,108 @@ wave_writer_create_wav (int rate, int channels, const String &filename, int mode
   return wavw;
 }
 
+// == AsyncWaveWriter ==
+class AsyncWaveWriterImpl : public AsyncWaveWriter {
+  WaveWriterP         writer_;
+  const uint          n_channels_;
+  const uint64        n_frames_;
+  std::vector<float>  ring_;                    // n_frames_ * n_channels_, interleaved
+  std::atomic<uint64> head_ alignas (64) = 0;   // frames enqueued by write()
+  std::atomic<uint64> tail_ alignas (64) = 0;   // frames consumed by encoder
+  std::atomic<uint64> dropped_ = 0;            // frames lost due to ring overflow
+  std::atomic<bool>   quit_ = false;
+  ScopedSemaphore     sem_;
+  std::thread        *thread_ = nullptr;
+  void
+  encoder_thread ()
+  {
+    this_thread_set_name ("AseWaveWriter");
+    bool quit = false;
+    while (!quit)
+      {
+        sem_.wait();
+        quit = quit_;
+        uint64 tail = tail_.load (std::memory_order_relaxed);
+        const uint64 head = head_.load (std::memory_order_acquire);
+        while (tail < head)
+          {
+            const uint64 offset = tail % n_frames_;
+            const uint64 n = std::min (head - tail, n_frames_ - offset);
+            writer_->write (&ring_[offset * n_channels_], n);
+            tail += n;
+            tail_.store (tail, std::memory_order_release);
+          }
+      }
+  }
+public:
+  AsyncWaveWriterImpl (WaveWriterP writer, uint n_channels, size_t ring_frames) :
+    writer_ (writer), n_channels_ (n_channels), n_frames_ (ring_frames), ring_ (ring_frames * n_channels)
+  {
+    thread_ = new std::thread (&AsyncWaveWriterImpl::encoder_thread, this);
+  }
+  ~AsyncWaveWriterImpl()
+  {
+    close();
+  }
+  String
+  name () const override
+  {
+    return writer_->name();
+  }
+  size_t
+  writable () const override
+  {
+    return n_frames_ - (head_.load (std::memory_order_relaxed) - tail_.load (std::memory_order_acquire));
+  }
+  uint64
+  n_dropped () const override
+  {
+    return dropped_;
+  }
+  ssize_t
+  write (const float *frames, size_t n_frames) override
+  {
+    // obstruction free, returns the number of frames that fit into the ring
+    uint64 head = head_.load (std::memory_order_relaxed);
+    const uint64 n_total = std::min (uint64 (n_frames), uint64 (writable()));
+    for (uint64 done = 0; done < n_total; )
+      {
+        const uint64 offset = head % n_frames_;
+        const uint64 n = std::min (n_total - done, n_frames_ - offset);
+        fast_copy (n * n_channels_, &ring_[offset * n_channels_], frames + done * n_channels_);
+        done += n;
+        head += n;
+      }
+    head_.store (head, std::memory_order_release);
+    if (n_total < n_frames)
+      dropped_ += n_frames - n_total;
+    if (n_total)
+      sem_.post();
+    return n_total;
+  }
+  bool
+  close () override
+  {
+    if (thread_)
+      {
+        quit_ = true;
+        sem_.post();
+        thread_->join();
+        delete thread_;
+        thread_ = nullptr;
+        return writer_->close();
+      }
+    return false;
+  }
+};
+
+AsyncWaveWriterP
+wave_writer_create_async (WaveWriterP writer, int channels, size_t ring_frames)
+{
+  assert_return (writer && channels > 0 && ring_frames > 0, nullptr);
+  return std::make_shared<AsyncWaveWriterImpl> (writer, channels, ring_frames);
+}
+
 // == OpusWriter ==
 String
 wave_writer_opus_version()
@@ -638,4 +741,58 @@ wave_writer_create_flac (int rate, int channels, const String &filename, int mod
   return ow;
 }
 
+// == Tests ==
+TEST_INTEGRITY (async_wave_writer_test);
+static void
+async_wave_writer_test()
+{
+  // collects written frames, the first write() blocks until released to force a ring overflow
+  struct TestWriter : WaveWriter {
+    std::vector<float> samples;
+    std::atomic<bool> entered = false, released = false;
+    String name () const override { return "TestWriter"; }
+    bool   close () override      { return true; }
+    ssize_t
+    write (const float *frames, size_t n_frames) override
+    {
+      entered = true;
+      while (!released)
+        std::this_thread::yield();
+      samples.insert (samples.end(), frames, frames + 2 * n_frames);
+      return n_frames;
+    }
+  };
+  auto twriter = std::make_shared<TestWriter>();
+  AsyncWaveWriterP awriter = wave_writer_create_async (twriter, 2, 8);
+  std::vector<float> input, expected;
+  auto write_frames = [&] (size_t n_frames) {
+    input.clear();
+    for (size_t i = 0; i < 2 * n_frames; i++)
+      input.push_back (expected.size() + i);
+    const ssize_t n = awriter->write (input.data(), n_frames);
+    expected.insert (expected.end(), input.begin(), input.begin() + 2 * n);
+    return n;
+  };
+  auto wait_drained = [&] () {
+    while (awriter->writable() < 8)
+      std::this_thread::yield();
+  };
+  // overflow while the encoder is busy
+  TASSERT (write_frames (5) == 5);
+  while (!twriter->entered)
+    std::this_thread::yield();
+  TASSERT (awriter->writable() == 3);
+  TASSERT (write_frames (6) == 3);
+  TASSERT (awriter->n_dropped() == 3);
+  twriter->released = true;
+  wait_drained();
+  // wrap around the end of the ring
+  TASSERT (write_frames (3) == 3);
+  wait_drained();
+  TASSERT (write_frames (7) == 7);
+  TASSERT (awriter->n_dropped() == 3);
+  TASSERT (awriter->close());
+  TASSERT (twriter->samples == expected);
+}
+
 } // Ase
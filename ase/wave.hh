@@ -15,6 +15,16 @@ public:
 };
 using WaveWriterP = std::shared_ptr<WaveWriter>;
 
+/// WaveWriter that queues frames through a lock-free ring for encoding in a background thread.
+class AsyncWaveWriter : public WaveWriter {
+public:
+  virtual size_t  writable   () const = 0; ///< Number of frames write() can currently accept.
+  virtual uint64  n_dropped  () const = 0; ///< Number of frames write() could not accept.
+};
+using AsyncWaveWriterP = std::shared_ptr<AsyncWaveWriter>;
+
+AsyncWaveWriterP wave_writer_create_async (WaveWriterP writer, int channels, size_t ring_frames = 256 * 1024);
+
 WaveWriterP wave_writer_create_wav (int rate, int channels, const String &filename, int mode = 0664, uint8_t n_bits = 32);
 
 WaveWriterP wave_writer_create_opus (int rate, int channels, const String &filename, int mode = 0664, int complexity = 10, float bitrate = 128);